@@ -32,6 +32,7 @@ void Auction::makeBid(const Bid& currentBid) {
     }
   }
   bidHistory_.push_back(currentBid);
+  updateLegalBids();
   if (isAuctionEnd() && lastestBidIdx_ >= 0) {
     contract_ = Bid(lastestBidIdx_);
     for (size_t i = 0; i < bidHistory_.size(); ++i) {
@@ -59,4 +60,25 @@ void Auction::makeBid(const Bid& currentBid) {
   // assert(declarer != NO_SEAT);
 }
 
+void Auction::updateLegalBids() {
+  // Can always pass, and only bid higher than the latest contract.
+  uint64_t common = kPassBidMask | kNormalBidsMask;
+  if (lastestBidIdx_ >= 0) {
+    common &= ~uint64_t(0) << (lastestBidIdx_ + 1);
+  }
+  for (int side = 0; side < 2; ++side) {
+    uint64_t mask = common;
+    if (highestBidPlayer_ != kNoSeat && !isBidRedoubled_) {
+      const bool ourContract = isPartner(side, highestBidPlayer_);
+      // Double the opponents' contract, redouble our doubled one.
+      if (!isBidDoubled_ && !ourContract) {
+        mask |= kDoubleBidMask;
+      } else if (isBidDoubled_ && ourContract) {
+        mask |= kRedoubleBidMask;
+      }
+    }
+    legalBids_[side] = mask;
+  }
+}
+
 }  // namespace bridge
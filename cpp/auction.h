@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <vector>
 
 #include "cpp/bid.h"
@@ -31,27 +32,13 @@ class Auction {
 
   const Bid& contract() const { return contract_; }
 
+  // Bit i is set iff Bid(i) is legal for currentSeat, see kNormalBidsMask.
+  uint64_t legalBids(int currentSeat) const {
+    return legalBids_[currentSeat & 1];
+  }
+
   bool isBidLegal(const Bid& currentBid, int currentSeat) const {
-    switch (currentBid.type()) {
-      case kBidPass: {
-        // Can always pass.
-        return true;
-      }
-      case kBidDouble: {
-        // Not doubled, not redobuled, cannot double your own contract.
-        return highestBidPlayer_ != kNoSeat && !isBidDoubled_ &&
-               !isBidRedoubled_ && !isPartner(currentSeat, highestBidPlayer_);
-      }
-      case kBidRedouble: {
-        // Doubled, not redoubled, can only redouble your own contract.
-        return isBidDoubled_ && !isBidRedoubled_ &&
-               isPartner(currentSeat, highestBidPlayer_);
-      }
-      case kBidNull: {
-        return false;
-      }
-      default: { return currentBid.index() > lastestBidIdx_; }
-    }
+    return (legalBids(currentSeat) >> currentBid.index()) & 1;
   }
 
   bool isAuctionEnd() const {
@@ -81,6 +68,12 @@ class Auction {
   bool isBidDoubled_ = false;
   bool isBidRedoubled_ = false;
   int illegalPlayer_ = kNoSeat;
+
+  // legal bids of each side (seat & 1), recomputed by makeBid
+  std::array<uint64_t, 2> legalBids_ = {{kNormalBidsMask | kPassBidMask,
+                                         kNormalBidsMask | kPassBidMask}};
+
+  void updateLegalBids();
 };
 
 }  // namespace bridge
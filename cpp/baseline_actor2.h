@@ -26,6 +26,11 @@ class BaselineActor2 : public rela::Actor2 {
     return [this]() { return this->reply(); };
   }
 
+  void setLegalActions(uint64_t mask) override {
+    legalMask_ = mask;
+    hasLegalMask_ = true;
+  }
+
   std::string visualizeState() const {
     // std::cout << "baseline s: " << std::endl;
     // rela::utils::tensorDictPrint(obs_);
@@ -48,6 +53,16 @@ class BaselineActor2 : public rela::Actor2 {
   std::shared_ptr<rela::Models> model_;
   rela::TensorDictFuture actionFuture_;
   rela::TensorDict obs_;
+  // from the env for the current act(), saves reading obs_["legal_move"]
+  uint64_t legalMask_ = 0;
+  bool hasLegalMask_ = false;
+
+  bool isLegal(int action) const {
+    if (hasLegalMask_) {
+      return (legalMask_ >> action) & 1;
+    }
+    return obs_.at("legal_move")[action].item<float>() == 1.0;
+  }
 
   rela::TensorDict reply() {
     auto action = actionFuture_();
@@ -59,7 +74,7 @@ class BaselineActor2 : public rela::Actor2 {
     float minCost = 1;
     int bestAction = kSpecialBidStart;
     for (int j = accessor.size(0) - 1; j > 0; j--) {
-      if (obs_["legal_move"][j - 1].item<float>() == 1.0) {
+      if (isLegal(j - 1)) {
         if (accessor[j] < minCost) {
           minCost = accessor[j];
           bestAction = j - 1;
@@ -80,6 +95,7 @@ class BaselineActor2 : public rela::Actor2 {
     if (obs_["baseline_convert"].item<float>() == 1.0) {
       a = kSpecialBidStart;
     }
+    hasLegalMask_ = false;
 
     /*
     Bid bid;
@@ -0,0 +1,144 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+//
+// Bidding steps/sec with the "single" feature: full recomputation per step
+// (hand bits, 40 x kAction auction block, isBidLegal per action) vs. a copy
+// of GameState's incrementally updated cache. Both replay the same random
+// legal auctions, so both also pay for the cache upkeep in biddingStep().
+// The cached features are checked against the full ones before timing.
+//
+// usage: feature_bench [games] [seed]
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "game_state.h"
+
+using namespace bridge;
+
+namespace {
+
+std::string randomPBN(std::mt19937& rng) {
+  std::array<int, kDeck> deck;
+  for (int i = 0; i < kDeck; ++i) {
+    deck[i] = i;
+  }
+  std::shuffle(deck.begin(), deck.end(), rng);
+
+  std::string pbn = "[Deal \"N:";
+  for (int seat = 0; seat < kPlayer; ++seat) {
+    std::sort(deck.begin() + seat * kHand, deck.begin() + (seat + 1) * kHand);
+    for (int suit = SPADE; suit >= CLUB; --suit) {
+      for (int i = 0; i < kHand; ++i) {
+        const Card card(deck[seat * kHand + i]);
+        if (card.suit() == suit) {
+          pbn += CardMap[card.value()];
+        }
+      }
+      if (suit != CLUB) {
+        pbn += '.';
+      }
+    }
+    pbn += seat + 1 < kPlayer ? ' ' : '"';
+  }
+  return pbn + "]";
+}
+
+struct Game {
+  std::string pbn;
+  int dealer;
+  Vulnerability vul;
+  std::vector<int> bids;
+};
+
+// random legal auctions, biased towards pass so they end in a realistic
+// number of steps
+std::vector<Game> makeGames(int numGames, std::mt19937& rng) {
+  GameState state(1);
+  const std::vector<int> ddTable(kStrain * kPlayer, 7);
+  std::uniform_real_distribution<float> coin;
+
+  std::vector<Game> games;
+  for (int g = 0; g < numGames; ++g) {
+    Game game{randomPBN(rng), (int)(rng() % kPlayer),
+              (Vulnerability)(rng() % NUM_VULNERABILITY), {}};
+    state.reset(game.pbn, ddTable, game.dealer, game.vul);
+    while (!state.biddingTerminal()) {
+      std::vector<int> legal;
+      for (int a = 0; a < kAction; ++a) {
+        if (state.isBidLegal(Bid(a))) {
+          legal.push_back(a);
+        }
+      }
+      int a = coin(rng) < 0.6 ? kSpecialBidStart : legal[rng() % legal.size()];
+      state.biddingStep(a);
+      game.bids.push_back(a);
+    }
+    games.push_back(std::move(game));
+  }
+  return games;
+}
+
+// replays every game, calling feature(state, seat, table, s) before each bid
+template <typename Func>
+std::pair<double, int> replay(const std::vector<Game>& games, Func&& feature) {
+  GameState state(1);
+  const std::vector<int> ddTable(kStrain * kPlayer, 7);
+  torch::Tensor s = torch::zeros({FeatureExtractor::featureDim()});
+  int steps = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& game : games) {
+    state.reset(game.pbn, ddTable, game.dealer, game.vul);
+    for (int a : game.bids) {
+      feature(state, state.getCurrentSeat(), state.getCurrentTableIdx(), s);
+      state.biddingStep(a);
+      ++steps;
+    }
+  }
+  auto stop = std::chrono::steady_clock::now();
+  return {std::chrono::duration<double>(stop - start).count(), steps};
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int numGames = argc > 1 ? std::stoi(argv[1]) : 20000;
+  const int seed = argc > 2 ? std::stoi(argv[2]) : 1;
+
+  std::mt19937 rng(seed);
+  const auto games = makeGames(numGames, rng);
+
+  // every seat, every step
+  replay(games, [](const GameState& state, int, int table, torch::Tensor&) {
+    FeatureExtractor extractor(state);
+    torch::Tensor full = torch::zeros({FeatureExtractor::featureDim()});
+    torch::Tensor cached = torch::zeros({FeatureExtractor::featureDim()});
+    for (int seat = 0; seat < kPlayer; ++seat) {
+      extractor.computeFeatureFull(seat, table, full);
+      extractor.computeFeature(seat, table, cached);
+      if (!torch::equal(full, cached)) {
+        std::cerr << "cached feature mismatch, seat " << seat << std::endl;
+        std::exit(1);
+      }
+    }
+  });
+
+  const auto before = replay(
+      games, [](const GameState& state, int seat, int table, torch::Tensor& s) {
+        FeatureExtractor(state).computeFeatureFull(seat, table, s);
+      });
+  const auto after = replay(
+      games, [](const GameState& state, int seat, int table, torch::Tensor& s) {
+        state.computeFeature2(seat, table, s);
+      });
+
+  std::cout << numGames << " games, " << before.second << " bidding steps"
+            << std::endl;
+  std::cout << "  before: " << before.second / before.first << " steps/sec"
+            << std::endl;
+  std::cout << "  after : " << after.second / after.first << " steps/sec"
+            << std::endl;
+  return 0;
+}
@@ -24,6 +24,19 @@ constexpr int kBidNull = 4;
 constexpr uint32_t kBidDoubledMask = 1;
 constexpr uint32_t kBidReDoubledMask = 2;
 
+// Bid masks: bit i is set iff Bid(i) is legal.
+constexpr uint64_t kNormalBidsMask = (uint64_t(1) << kNumNormalBids) - 1;
+constexpr uint64_t kPassBidMask = uint64_t(1) << kNumNormalBids;
+constexpr uint64_t kDoubleBidMask = uint64_t(1) << (kNumNormalBids + 1);
+constexpr uint64_t kRedoubleBidMask = uint64_t(1) << (kNumNormalBids + 2);
+
+// out[i] = bit i of mask for i < n <= 64, no branches so that it vectorizes.
+inline void expandBidMask(uint64_t mask, int n, float* out) {
+  for (int i = 0; i < n; ++i) {
+    out[i] = static_cast<float>((mask >> i) & 1);
+  }
+}
+
 class Bid {
  public:
   Bid() = default;
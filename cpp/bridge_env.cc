@@ -125,6 +125,30 @@ json BridgeEnv::jsonObj() const {
   return j;
 }
 
+void BridgeEnv::writeFeature(const rela::TensorDict& batch, int row) const {
+  if (option_.saveFeatureHistory) {
+    // feature() records the history
+    rela::Env::writeFeature(batch, row);
+    return;
+  }
+  const int seat = state_.getCurrentSeat();
+  const int tableIdx = state_.getCurrentTableIdx();
+
+  // "s" is computed in place, the small fields are copied into their rows
+  torch::Tensor s = batch.at("s")[row];
+  s.zero_();
+  computeFeature(seat, tableIdx, s);
+
+  const auto baselineS = state_.computeBaselineFeature2(seat, tableIdx);
+  batch.at("baseline_s")[row].copy_(baselineS.at("s"));
+  batch.at("baseline_convert")[row].copy_(baselineS.at("convert"));
+  batch.at("legal_move")[row].copy_(state_.computeLegalMove2(seat, tableIdx));
+  batch.at("strain")[row].fill_(state_.getContractStrain(tableIdx));
+  for (const auto& kv : state_.computePartnerInfo(seat)) {
+    batch.at(kv.first)[row].copy_(kv.second);
+  }
+}
+
 rela::TensorDict BridgeEnv::getPlayingFeature(int tableIdx, int seat,
                                               bool gtCards) const {
   torch::Tensor selfHand = state_.computeHandFeature(seat, tableIdx);
@@ -61,6 +61,8 @@ class BridgeEnv : public rela::Env {
     extractParams(gameParams, "sampler", &option_.sampler, false);
     extractParams(gameParams, "save_feature_history",
                   &option_.saveFeatureHistory, false);
+    extractParams(gameParams, "verify_feature", &option_.verifyFeature, false);
+    state_.setVerifyFeature(option_.verifyFeature);
 
     extractParams(gameParams, "fixed_vul", &option_.fixedVul, false);
     extractParams(gameParams, "fixed_dealer", &option_.fixedDealer, false);
@@ -98,8 +100,14 @@ class BridgeEnv : public rela::Env {
   }
 
   torch::Tensor getFeature(int seat, int tableIdx) const {
-    std::string featureType = getFeatureType(tableIdx, seat);
     torch::Tensor s = torch::zeros({featureSize_});
+    computeFeature(seat, tableIdx, s);
+    return s;
+  }
+
+  // s: zeroed float tensor of size featureSize_
+  void computeFeature(int seat, int tableIdx, torch::Tensor& s) const {
+    std::string featureType = getFeatureType(tableIdx, seat);
 
     if (featureType == "single") {
       state_.computeFeature2(seat, tableIdx, s);
@@ -109,8 +117,6 @@ class BridgeEnv : public rela::Env {
     } else {
       throw std::runtime_error("Feature type invalid: " + featureType);
     }
-
-    return s;
   }
 
   int maxNumAction() const override { return kAction; }
@@ -127,6 +133,15 @@ class BridgeEnv : public rela::Env {
 
   int playerIdx() const override { return state_.playerIdx(); }
 
+  bool legalActionBits(uint64_t* mask) const override {
+    if (terminated_) {
+      return false;
+    }
+    *mask = state_.legalBidMask(state_.getCurrentSeat(),
+                                state_.getCurrentTableIdx());
+    return true;
+  }
+
   float playerReward(int playerIdx) const override {
     if (playerIdx % 2 == 0)
       return state_.getReward();
@@ -227,6 +242,8 @@ class BridgeEnv : public rela::Env {
     return featureWithTableSeat(currTable, currSeat, false);
   }
 
+  void writeFeature(const rela::TensorDict& batch, int row) const override;
+
   bool hasOpeningLead(int tableIdx) const {
     return state_.getDeclarer(tableIdx) >= 0;
   }
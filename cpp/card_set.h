@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+
+#include "cpp/card.h"
+
+namespace bridge {
+
+// High card points of the low 4 bits of a suit (A, K, Q, J, see cardToIndex).
+constexpr int kSuitHcp[16] = {0, 4, 3, 7, 2, 6, 5, 9,
+                              1, 5, 4, 8, 3, 7, 6, 10};
+
+// A set of cards in one 64-bit word: bit Card::index() per card, so suit s
+// takes bits [s * kSuitSize, (s + 1) * kSuitSize).
+class CardSet {
+ public:
+  static constexpr uint64_t kSuitMask = (uint64_t(1) << kSuitSize) - 1;
+
+  CardSet() = default;
+
+  explicit CardSet(uint64_t bits) : bits_(bits) {}
+
+  uint64_t bits() const { return bits_; }
+
+  bool contains(const Card& card) const {
+    return (bits_ >> card.index()) & 1;
+  }
+
+  void add(const Card& card) { bits_ |= uint64_t(1) << card.index(); }
+
+  void remove(const Card& card) { bits_ &= ~(uint64_t(1) << card.index()); }
+
+  void clear() { bits_ = 0; }
+
+  bool empty() const { return bits_ == 0; }
+
+  int size() const { return __builtin_popcountll(bits_); }
+
+  // cards of one suit, bit i for value i
+  uint32_t suit(int suit) const {
+    return (bits_ >> (suit * kSuitSize)) & kSuitMask;
+  }
+
+  uint64_t suitBits(int suit) const {
+    return bits_ & (kSuitMask << (suit * kSuitSize));
+  }
+
+  int suitLength(int suit) const { return __builtin_popcount(this->suit(suit)); }
+
+  int hcp() const {
+    int result = 0;
+    for (int i = 0; i < kNumSuits; ++i) {
+      result += kSuitHcp[suit(i) & 0xF];
+    }
+    return result;
+  }
+
+  // out[i] = 1 if card i is in the set, 0 otherwise, for the whole deck.
+  // out is a pointer or a 1-d TensorAccessor; the loop has no branches so
+  // that it vectorizes on contiguous output.
+  template <typename Out>
+  void writeTo(Out out) const {
+    for (int i = 0; i < kDeckSize; ++i) {
+      out[i] = (bits_ >> i) & 1;
+    }
+  }
+
+ private:
+  uint64_t bits_ = 0;
+};
+
+inline bool operator==(const CardSet& lhs, const CardSet& rhs) {
+  return lhs.bits() == rhs.bits();
+}
+
+}  // namespace bridge
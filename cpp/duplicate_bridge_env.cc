@@ -240,95 +240,109 @@ float DuplicateBridgeEnv::playerRawScore(int player) const {
 }
 
 rela::TensorDict DuplicateBridgeEnv::feature() const {
-  return {{"vul", vulTensor()},
-          {"stage", gameStageTensor()},
-          {"bid", biddingSequenceTensor()},
-          {"contract", contractTensor()},
-          {"doubled", doubledTensor()},
-          {"declarer", declarerTensor()},
-          {"s", situationTensor()},
-          {"trick", currentTrickTensor()},
-          {"play", playingSequenceTensor()},
-          {"legal_move", legalActionsTensor()}};
+  rela::TensorDict batch = {
+      {"vul", torch::empty({1, 2}, torch::kFloat)},
+      {"stage", torch::empty({1, 1}, torch::kInt64)},
+      {"bid", torch::empty({1, kMaxBiddingHistory, 2}, torch::kInt64)},
+      {"contract", torch::empty({1, 1}, torch::kInt64)},
+      {"doubled", torch::empty({1, 2}, torch::kFloat)},
+      {"declarer", torch::empty({1, 1}, torch::kInt64)},
+      {"s", torch::empty({1, kNumPlayers, kDeckSize}, torch::kFloat)},
+      {"trick", torch::empty({1, kNumPlayers}, torch::kInt64)},
+      {"play", torch::empty({1, kDeckSize, 2}, torch::kInt64)},
+      {"legal_move", torch::empty({1, kNumActions}, torch::kFloat)}};
+  writeFeature(batch, 0);
+  for (auto& kv : batch) {
+    kv.second = kv.second[0];
+  }
+  return batch;
+}
+
+void DuplicateBridgeEnv::writeFeature(const rela::TensorDict& batch,
+                                      int row) const {
+  writeVul(batch.at("vul").accessor<float, 2>()[row]);
+  writeGameStage(batch.at("stage").accessor<int64_t, 2>()[row]);
+  writeBiddingSequence(batch.at("bid").accessor<int64_t, 3>()[row]);
+  writeContract(batch.at("contract").accessor<int64_t, 2>()[row]);
+  writeDoubled(batch.at("doubled").accessor<float, 2>()[row]);
+  writeDeclarer(batch.at("declarer").accessor<int64_t, 2>()[row]);
+  writeSituation(batch.at("s").accessor<float, 3>()[row]);
+  writeCurrentTrick(batch.at("trick").accessor<int64_t, 2>()[row]);
+  writePlayingSequence(batch.at("play").accessor<int64_t, 3>()[row]);
+  writeLegalActions(batch.at("legal_move").accessor<float, 2>()[row]);
 }
 
-torch::Tensor DuplicateBridgeEnv::vulTensor() const {
+void DuplicateBridgeEnv::writeVul(torch::TensorAccessor<float, 1> out) const {
   const GameState2* game = games_.at(gameIndex_).get();
   const int vul = game->vul();
   const int selfSide = (game->currentSeat() & 1);
   const int oppoSide = (selfSide ^ 1);
-  return torch::tensor({static_cast<float>((vul >> selfSide) & 1),
-                        static_cast<float>((vul >> oppoSide) & 1)},
-                       torch::kFloat);
+  out[0] = static_cast<float>((vul >> selfSide) & 1);
+  out[1] = static_cast<float>((vul >> oppoSide) & 1);
 }
 
-torch::Tensor DuplicateBridgeEnv::gameStageTensor() const {
-  const int64_t stage =
-      games_.at(gameIndex_)->currentStage() == kStageBidding ? 0 : 1;
-  return torch::tensor({stage}, torch::kInt64);
+void DuplicateBridgeEnv::writeGameStage(
+    torch::TensorAccessor<int64_t, 1> out) const {
+  out[0] = games_.at(gameIndex_)->currentStage() == kStageBidding ? 0 : 1;
 }
 
-torch::Tensor DuplicateBridgeEnv::biddingSequenceTensor() const {
+void DuplicateBridgeEnv::writeBiddingSequence(
+    torch::TensorAccessor<int64_t, 2> out) const {
   const GameState2* game = games_.at(gameIndex_).get();
   const auto& biddingSeq = game->biddingHistory();
   const int seqLen = biddingSeq.size();
   const int dealer = game->dealer();
   const int self = game->currentSeat();
   const Bid kNull;
-  torch::Tensor result = torch::empty({kMaxBiddingHistory, 2}, torch::kInt64);
-  auto data = result.accessor<int64_t, 2>();
   if (seqLen <= kMaxBiddingHistory) {
     for (int i = 0; i < seqLen; ++i) {
-      data[i][0] = biddingSeq[i].index();
-      data[i][1] = relativeSeat(self, (dealer + i) % kNumPlayers);
+      out[i][0] = biddingSeq[i].index();
+      out[i][1] = relativeSeat(self, (dealer + i) % kNumPlayers);
     }
     for (int i = seqLen; i < kMaxBiddingHistory; ++i) {
-      data[i][0] = kNull.index();
-      data[i][1] = kNoSeat;
+      out[i][0] = kNull.index();
+      out[i][1] = kNoSeat;
     }
   } else {
     const int offset = seqLen - kMaxBiddingHistory;
     for (int i = 0; i < kMaxBiddingHistory; ++i) {
       const int p = i + offset;
-      data[i][0] = biddingSeq[p].index();
-      data[i][1] = relativeSeat(self, (dealer + p) % kNumPlayers);
+      out[i][0] = biddingSeq[p].index();
+      out[i][1] = relativeSeat(self, (dealer + p) % kNumPlayers);
     }
   }
-  return result;
 }
 
-torch::Tensor DuplicateBridgeEnv::contractTensor() const {
-  const Bid& contract = games_.at(gameIndex_)->contract();
-  return torch::tensor({static_cast<int64_t>(contract.index())}, torch::kInt64);
+void DuplicateBridgeEnv::writeContract(
+    torch::TensorAccessor<int64_t, 1> out) const {
+  out[0] = games_.at(gameIndex_)->contract().index();
 }
 
-torch::Tensor DuplicateBridgeEnv::doubledTensor() const {
+void DuplicateBridgeEnv::writeDoubled(
+    torch::TensorAccessor<float, 1> out) const {
   const uint32_t doubled = games_.at(gameIndex_)->doubled();
-  return torch::tensor(
-      {static_cast<float>(doubled & 1), static_cast<float>((doubled >> 1) & 1)},
-      torch::kFloat);
+  out[0] = static_cast<float>(doubled & 1);
+  out[1] = static_cast<float>((doubled >> 1) & 1);
 }
 
-torch::Tensor DuplicateBridgeEnv::declarerTensor() const {
+void DuplicateBridgeEnv::writeDeclarer(
+    torch::TensorAccessor<int64_t, 1> out) const {
   const GameState2* game = games_.at(gameIndex_).get();
-  const int64_t declarer =
-      game->currentStage() == kStageBidding
-          ? kNoSeat
-          : relativeSeat(game->currentSeat(), game->declarer());
-  return torch::tensor({declarer}, torch::kInt64);
+  out[0] = game->currentStage() == kStageBidding
+               ? kNoSeat
+               : relativeSeat(game->currentSeat(), game->declarer());
 }
 
-torch::Tensor DuplicateBridgeEnv::situationTensor() const {
+void DuplicateBridgeEnv::writeSituation(
+    torch::TensorAccessor<float, 2> out) const {
   const GameState2* game = games_.at(gameIndex_).get();
   const auto& hands = game->hands();
 
-  torch::Tensor result = torch::zeros({kNumPlayers, kDeckSize}, torch::kFloat);
-  auto data = result.accessor<float, 2>();
-
   // self hand.
-  for (int i = 0; i < kDeckSize; ++i) {
-    if (hands.at(game->currentSeat()).containsCard(Card(i))) {
-      data[0][i] = 1.0f;
+  hands.at(game->currentSeat()).cards().writeTo(out[0]);
+  for (int p = 1; p < kNumPlayers; ++p) {
+    for (int i = 0; i < kDeckSize; ++i) {
+      out[p][i] = 0.0f;
     }
   }
 
@@ -342,47 +356,37 @@ torch::Tensor DuplicateBridgeEnv::situationTensor() const {
 
     if (!game->playingHistory().empty()) {
       // dummy hand.
-      for (int i = 0; i < kDeckSize; ++i) {
-        if (hands.at(dummySeat).containsCard(Card(i))) {
-          data[dummyPos][i] = 1.0f;
-        }
-      }
+      hands.at(dummySeat).cards().writeTo(out[dummyPos]);
     }
   }
-
-  return result;
 }
 
-torch::Tensor DuplicateBridgeEnv::currentTrickTensor() const {
+void DuplicateBridgeEnv::writeCurrentTrick(
+    torch::TensorAccessor<int64_t, 1> out) const {
   const GameState2* game = games_.at(gameIndex_).get();
   const auto& currentTrick = game->currentTrick();
-  torch::Tensor result = torch::empty({kNumPlayers}, torch::kInt64);
-  auto data = result.accessor<int64_t, 1>();
   for (int i = 0; i < kNumPlayers; ++i) {
     const int pos = relativeSeat(game->currentSeat(), i);
     const Card& card = currentTrick.at(i);
-    data[pos] = card.suit() == kNoSuit ? kDeckSize : card.index();
+    out[pos] = card.suit() == kNoSuit ? kDeckSize : card.index();
   }
-  return result;
 }
 
-torch::Tensor DuplicateBridgeEnv::playingSequenceTensor() const {
+void DuplicateBridgeEnv::writePlayingSequence(
+    torch::TensorAccessor<int64_t, 2> out) const {
   const GameState2* game = games_.at(gameIndex_).get();
   const auto& playSeq = game->playingHistory();
   const int seqLen = playSeq.size();
   const int self = game->currentSeat();
-  torch::Tensor result = torch::empty({kDeckSize, 2}, torch::kInt64);
-  auto data = result.accessor<int64_t, 2>();
   for (int i = 0; i < seqLen; ++i) {
     const auto& it = playSeq[i];
-    data[i][0] = it.first.index();
-    data[i][1] = relativeSeat(self, it.second);
+    out[i][0] = it.first.index();
+    out[i][1] = relativeSeat(self, it.second);
   }
   for (int i = seqLen; i < kDeckSize; ++i) {
-    data[i][0] = kDeckSize;
-    data[i][1] = kNoSeat;
+    out[i][0] = kDeckSize;
+    out[i][1] = kNoSeat;
   }
-  return result;
 }
 
 // torch::Tensor DuplicateBridgeEnv::winningSeatsTensor() const {
@@ -398,22 +402,22 @@ torch::Tensor DuplicateBridgeEnv::playingSequenceTensor() const {
 //   return result;
 // }
 
-torch::Tensor DuplicateBridgeEnv::legalActionsTensor() const {
+void DuplicateBridgeEnv::writeLegalActions(
+    torch::TensorAccessor<float, 1> out) const {
   const GameState2* game = games_.at(gameIndex_).get();
   const uint64_t legalActionsMask = game->legalActions();
 
   const int size = game->currentStage() == kStageBidding ? kNumBids : kDeckSize;
   const int offset = game->currentStage() == kStageBidding ? 0 : kNumBids;
 
-  torch::Tensor result = torch::zeros({maxNumAction()}, torch::kFloat);
-  auto data = result.accessor<float, 1>();
+  for (int i = 0; i < kNumActions; ++i) {
+    out[i] = 0.0f;
+  }
   for (int i = 0; i < size; ++i) {
     if ((legalActionsMask >> i) & 1) {
-      data[offset + i] = 1.0f;
+      out[offset + i] = 1.0f;
     }
   }
-
-  return result;
 }
 
 }  // namespace bridge
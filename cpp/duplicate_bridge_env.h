@@ -63,6 +63,15 @@ class DuplicateBridgeEnv : public rela::Env {
 
   int maxNumAction() const override { return kNumActions; }
 
+  // Only while bidding: the card actions start at kNumBids and don't fit.
+  bool legalActionBits(uint64_t* mask) const override {
+    if (terminated_ || currentStage() != kStageBidding) {
+      return false;
+    }
+    *mask = games_.at(gameIndex_)->legalActions();
+    return true;
+  }
+
   rela::EnvSpec spec() const override {
     return {-1,
             -1,
@@ -73,6 +82,8 @@ class DuplicateBridgeEnv : public rela::Env {
 
   rela::TensorDict feature() const override;
 
+  void writeFeature(const rela::TensorDict& batch, int row) const override;
+
   void step(int act) override;
 
   float playerReward(int player) const override;
@@ -104,52 +115,54 @@ class DuplicateBridgeEnv : public rela::Env {
 
   bool resetWithDatabase();
 
+  // The feature writers below fill one row and overwrite all of it.
+
   // Vul mask tensor.
   // size = (2,), dtype = float.
   // 0 for self, 1 for opposite.
-  torch::Tensor vulTensor() const;
+  void writeVul(torch::TensorAccessor<float, 1> out) const;
 
   // Game stage tensor.
   // size = (1,), dtype = long.
   // 0-bidding, 1-playing
-  torch::Tensor gameStageTensor() const;
+  void writeGameStage(torch::TensorAccessor<int64_t, 1> out) const;
 
   // Bidding sequence start from relative position of dealer, pre-pad with
   // kBidNull.
   // size = (40, 2), dtype = long.
   // The 1st col is the bid index.
   // The 2nd col is the player's relative seat.
-  torch::Tensor biddingSequenceTensor() const;
+  void writeBiddingSequence(torch::TensorAccessor<int64_t, 2> out) const;
 
   // Contract index tensor.
   // size = (1,), dtype = long.
-  torch::Tensor contractTensor() const;
+  void writeContract(torch::TensorAccessor<int64_t, 1> out) const;
 
   // Doubled status of the bidding.
   // size = (2,), dtype = float.
   // 00 for no double, 01 for doubled, 10 for re-doubled.
-  torch::Tensor doubledTensor() const;
+  void writeDoubled(torch::TensorAccessor<float, 1> out) const;
 
   // Declarer relative postion tensor.
   // size = (1,), dtype = long.
   // Relative seat: 0-self, 1-left, 2-partner, 3-right
-  torch::Tensor declarerTensor() const;
+  void writeDeclarer(torch::TensorAccessor<int64_t, 1> out) const;
 
   // Mask tensor for current situation.
   // size = (4, 52), dtype = float.
   // Position for 1st dim: (self, left, partner, right)
-  torch::Tensor situationTensor() const;
+  void writeSituation(torch::TensorAccessor<float, 2> out) const;
 
   // Current trick tensor.
   // size = (4,), dtype = long.
   // Position for 1st dim: (self, left, partner, right)
-  torch::Tensor currentTrickTensor() const;
+  void writeCurrentTrick(torch::TensorAccessor<int64_t, 1> out) const;
 
   // Playing sequence tensor.
   // size = (52, 2), dtype = long.
   // The 1st col is the card index, 52 is the padding index for embedding.
   // The 2nd col is the player's relative seat.
-  torch::Tensor playingSequenceTensor() const;
+  void writePlayingSequence(torch::TensorAccessor<int64_t, 2> out) const;
 
   // Relative winning seat for each trick tensor.
   // size = (13,), dtype = long.
@@ -158,8 +171,8 @@ class DuplicateBridgeEnv : public rela::Env {
   // torch::Tensor winningSeatsTensor() const;
 
   // Mask for legal actions.
-  // if bidding, size = (39,) else if playing, size = (52,), dtype = float.
-  torch::Tensor legalActionsTensor() const;
+  // size = (kNumActions,), dtype = float; bids first, then cards.
+  void writeLegalActions(torch::TensorAccessor<float, 1> out) const;
 
   std::shared_ptr<DBInterface> database_ = nullptr;
   std::shared_ptr<DBInterface::Handle> handle_ = nullptr;
@@ -18,6 +18,8 @@ struct GameOption {
   std::string sampler = "uniform";
   std::string featureVer;
   bool saveFeatureHistory = false;
+  // check the incremental features against a full recomputation (slow)
+  bool verifyFeature = false;
 
   bool saveOutput = false;
 
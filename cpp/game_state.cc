@@ -5,32 +5,108 @@ namespace bridge {
 torch::Tensor GameState::computeHandFeature(int currSeat,
                                             int /* tableIdx */) const {
   torch::Tensor result = torch::empty({kDeck}, torch::kInt64);
-  auto data = result.accessor<int64_t, 1>();
-  for (int i = 0; i < kSuit; ++i) {
-    for (int j = 0; j < kCardsPerSuit; ++j) {
-      data[i * kCardsPerSuit + j] = hands_[currSeat].containsCard({i, j});
-    }
-  }
+  hands_[currSeat].cards().writeTo(result.data_ptr<int64_t>());
   return result;
 }
 
 torch::Tensor GameState::computePlayedCardsFeature(int tableIdx) const {
-  const auto& cardsPlayed = playingSequences_[tableIdx].cardsPlayed();
   torch::Tensor result = torch::empty({kDeck}, torch::kInt64);
-  auto data = result.accessor<int64_t, 1>();
-  for (int i = 0; i < kDeck; ++i) {
-    data[i] = (cardsPlayed[i] > 0);
-  }
+  playingSequences_[tableIdx].cardsPlayed().writeTo(
+      result.data_ptr<int64_t>());
   return result;
 }
 
 void FeatureExtractor::computeFeature(int currSeat, int currTableIdx,
                                       torch::Tensor& s) const {
+  assert(currSeat >= 0 && currSeat < kPlayer);
+  assert(currTableIdx >= 0 && currTableIdx < (int)s_.auctions_.size());
+  RELA_CHECK_GE(s.size(0), _kFeatureDim);
+  if (!s_.featureCache_.valid()) {
+    resetCache(s_.featureCache_);
+  }
+  const float* cached =
+      s_.featureCache_.data_.data() +
+      (currTableIdx * kPlayer + currSeat) * _kFeatureDim;
+
+  if (s.is_contiguous()) {
+    std::copy(cached, cached + _kFeatureDim, s.data_ptr<float>());
+  } else {
+    auto f = s.accessor<float, 1>();
+    for (int i = 0; i < _kFeatureDim; ++i) {
+      f[i] = cached[i];
+    }
+  }
+
+  if (s_.verifyFeature_) {
+    torch::Tensor full = torch::zeros({_kFeatureDim});
+    computeFeatureFull(currSeat, currTableIdx, full);
+    auto f = full.accessor<float, 1>();
+    for (int i = 0; i < _kFeatureDim; ++i) {
+      RELA_CHECK(f[i] == cached[i], "cached feature mismatch at ", i,
+                 ", seat ", currSeat, ", table ", currTableIdx, ": ",
+                 cached[i], " vs ", f[i]);
+    }
+  }
+}
+
+void FeatureExtractor::computeFeatureFull(int currSeat, int currTableIdx,
+                                          torch::Tensor& s) const {
   s_.saveHandTo(currSeat, s);
   saveAuctionTo(currSeat, currTableIdx, s);
   s_.saveAvailableBids(currSeat, currTableIdx, s, _kAvailStart);
 }
 
+void FeatureExtractor::resetCache(FeatureCache& cache) const {
+  const int numTables = (int)s_.auctions_.size();
+  cache.data_.assign(numTables * kPlayer * _kFeatureDim, 0);
+  cache.valid_ = true;
+
+  for (int tableIdx = 0; tableIdx < numTables; ++tableIdx) {
+    for (int seatIdx = 0; seatIdx < kPlayer; ++seatIdx) {
+      torch::Tensor s = torch::from_blob(
+          cache.data_.data() + (tableIdx * kPlayer + seatIdx) * _kFeatureDim,
+          {_kFeatureDim});
+      computeFeatureFull(seatIdx, tableIdx, s);
+    }
+  }
+}
+
+void FeatureExtractor::cacheBid(FeatureCache& cache, int tableIdx) const {
+  if (!cache.valid_) {
+    return;
+  }
+  const Auction& currentAuction = s_.auctions_[tableIdx];
+  // the new bid is the last one in the history
+  const int i = (int)currentAuction.bidHistory().size() - 1;
+  const int idx = currentAuction.bidHistory().back().index();
+
+  for (int seatIdx = 0; seatIdx < kPlayer; ++seatIdx) {
+    float* f =
+        cache.data_.data() + (tableIdx * kPlayer + seatIdx) * _kFeatureDim;
+
+    // same position as in saveAuctionTo
+    int relativePlayer = i + (s_.dealer_ - seatIdx + kPlayer) % kPlayer;
+    if (relativePlayer < _kMaxHistLen) {
+      f[_kMyBidStart + relativePlayer * kAction + idx] = 1;
+    }
+
+    expandBidMask(currentAuction.legalBids(seatIdx), kAction,
+                  f + _kAvailStart);
+  }
+}
+
+void FeatureExtractor::cachePlay(FeatureCache& cache, int seat,
+                                 const Card& card) const {
+  if (!cache.valid_) {
+    return;
+  }
+  // hands are shared by all tables
+  const int offset = card.suit() * kCardsPerSuit + card.value();
+  for (int tableIdx = 0; tableIdx < (int)s_.auctions_.size(); ++tableIdx) {
+    cache.data_[(tableIdx * kPlayer + seat) * _kFeatureDim + offset] = 0;
+  }
+}
+
 rela::TensorDict FeatureExtractor::computePartnerInfo(int currSeat) const {
   torch::Tensor s = torch::zeros({kSuit * kCardsPerSuit});
   s_.saveHandTo((currSeat + 2) % kPlayer, s);
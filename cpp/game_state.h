@@ -20,14 +20,48 @@ namespace bridge {
 
 class GameState;
 
+// GameState's cached "single" features, see FeatureExtractor::resetCache.
+// A copy starts out stale and is rebuilt from the state that owns it on
+// first use, so GameState keeps its defaulted copy constructor.
+class FeatureCache {
+ public:
+  FeatureCache() = default;
+
+  FeatureCache(const FeatureCache&) {}
+
+  FeatureCache& operator=(const FeatureCache&) {
+    valid_ = false;
+    return *this;
+  }
+
+  bool valid() const { return valid_; }
+
+ private:
+  friend class FeatureExtractor;
+
+  std::vector<float> data_;
+  bool valid_ = false;
+};
+
 class FeatureExtractor {
  public:
   FeatureExtractor(const GameState& s) : s_(s) {}
+  // Copies the feature from GameState's cache. With GameState's verify mode
+  // on it is also rebuilt by computeFeatureFull() and the two compared.
   void computeFeature(int currSeat, int currTableIdx, torch::Tensor& s) const;
+  void computeFeatureFull(int currSeat, int currTableIdx,
+                          torch::Tensor& s) const;
   static int featureDim() { return _kFeatureDim; }
   static std::vector<Bid> getBidFromFeature(const torch::Tensor& s);
   rela::TensorDict computePartnerInfo(int currSeat) const;
 
+  // Upkeep of the cache, [table][seat][featureDim()] floats: a full build
+  // on reset, or on first use of a stale one, then one delta per bid or
+  // card played. Deltas to a stale cache are skipped.
+  void resetCache(FeatureCache& cache) const;
+  void cacheBid(FeatureCache& cache, int tableIdx) const;
+  void cachePlay(FeatureCache& cache, int seat, const Card& card) const;
+
  private:
   const GameState& s_;
 
@@ -83,10 +117,7 @@ class FeatureExtractorOld {
 
 class GameState {
  public:
-  GameState(int numTables)
-      : featureExtractor_(*this),
-        featureExtractorBaseline_(*this),
-        featureExtractorOld_(*this) {
+  GameState(int numTables) {
     while ((int)auctions_.size() < numTables) {
       Auction auction;
       auctions_.push_back(auction);
@@ -118,17 +149,12 @@ class GameState {
     currentSeat_ = dealer_;
 
     // std::shuffle(std::begin(deal), std::end(deal), rng_);
-    std::fill(hcps_.begin(), hcps_.end(), 0);
     // std::cout << "dealing cards" << std::endl;
     for (int i = 0; i < kPlayer; ++i) {
-      std::fill(suitStats_[i].begin(), suitStats_[i].end(), 0);
       hands_[i].clear();
-      // Fill hands_ and stats from deal
+      // Fill hands_ from deal
       for (int j = 0; j < kHand; ++j) {
-        const Card card(deal_[i * kHand + j]);
-        hands_[i].add(card);
-        ++suitStats_[i][card.suit()];
-        hcps_[i] += HCPMap[card.value()];
+        hands_[i].add(Card(deal_[i * kHand + j]));
       }
     }
     for (size_t i = 0; i < auctions_.size(); i++) {
@@ -153,6 +179,8 @@ class GameState {
     tableIdx_ = 0;
     rawScores_.clear();
     trick2Take_.clear();
+
+    FeatureExtractor(*this).resetCache(featureCache_);
   }
 
   void playingStep(int actionIdx) {
@@ -165,6 +193,7 @@ class GameState {
     RELA_CHECK(isPlayLegal, "card play ", c.toString(),
                " is illegal for player ", pIdx);
     hands_[currentSeat_].remove(c);
+    FeatureExtractor(*this).cachePlay(featureCache_, currentSeat_, c);
     currentSeat_ = playingSequence.makePlay(c, currentSeat_);
   }
 
@@ -329,7 +358,18 @@ class GameState {
     return currentAuction.isBidLegal(bid, currentSeat_);
   }
 
-  void makeBid(Bid bid) { auctions_[tableIdx_].makeBid(bid); }
+  // bit i is set iff Bid(i) is legal for currSeat, see Auction::legalBids
+  uint64_t legalBidMask(int currSeat, int tableIdx) const {
+    return auctions_[tableIdx].legalBids(currSeat);
+  }
+
+  void makeBid(Bid bid) {
+    auctions_[tableIdx_].makeBid(bid);
+    FeatureExtractor(*this).cacheBid(featureCache_, tableIdx_);
+  }
+
+  // rebuild every cached feature from scratch and check it against the cache
+  void setVerifyFeature(bool verify) { verifyFeature_ = verify; }
 
   void setBidOtherChoices(std::vector<Bid>&& others) {
     auctions_[tableIdx_].setOtherChoices(std::move(others));
@@ -348,12 +388,14 @@ class GameState {
       if ((player >= 0) && (i != player)) {
         continue;
       }
+      const CardSet& dealt = hands_[i].originalCards();
       resultString << i << "    ";
       for (int j = 0; j < kSuit; j++) {
-        resultString << suitStats_[i][kSuit - 1 - j] << "   ";
+        resultString << dealt.suitLength(kSuit - 1 - j) << "   ";
       }
-      resultString << hcps_[i];
-      if (hcps_[i] < 10) resultString << " ";
+      const int hcp = dealt.hcp();
+      resultString << hcp;
+      if (hcp < 10) resultString << " ";
       resultString << "   " << hands_[i].originalHandString() << std::endl;
     }
     return resultString.str();
@@ -465,17 +507,9 @@ class GameState {
   }
 
   torch::Tensor computeLegalMove2(int currSeat, int tableIdx) const {
-    torch::Tensor legalMove = torch::zeros({kAction});
-
-    auto f = legalMove.accessor<float, 1>();
-    const Auction& currentAuction = auctions_[tableIdx];
-
-    for (int j = 0; j < kAction; j++) {
-      Bid tmpBid(j);
-      // tmpBid.fromIdx(j);
-      f[j] = currentAuction.isBidLegal(tmpBid, currSeat) ? 1 : 0;
-      // std::cout << f[availStart + j];
-    }
+    torch::Tensor legalMove = torch::empty({kAction});
+    expandBidMask(legalBidMask(currSeat, tableIdx), kAction,
+                  legalMove.data_ptr<float>());
     return legalMove;
   }
 
@@ -493,13 +527,10 @@ class GameState {
       // 0 - self, 1 - left opponent, 2 - partner, 3 - right opponent.
       int relativeEncoding = (k - currSeat + kPlayer) % kPlayer;
 
-      for (int i = 0; i < kSuit; i++) {
-        for (int j = 0; j < kCardsPerSuit; j++) {
-          if (hands_[k].containsCard({i, j})) {
-            // Order: C AKQJ..2, D AKQJ..2, H AKQJ..2, S AKQJ..2
-            f[i * kCardsPerSuit + j] = relativeEncoding;
-          }
-        }
+      // Order: C AKQJ..2, D AKQJ..2, H AKQJ..2, S AKQJ..2
+      for (uint64_t bits = hands_[k].cards().bits(); bits != 0;
+           bits &= bits - 1) {
+        f[__builtin_ctzll(bits)] = relativeEncoding;
       }
     }
 
@@ -513,40 +544,30 @@ class GameState {
     // For each card, specify where it is.
     // Order: NESW
     for (int k = 0; k < kPlayer; k++) {
-      for (int i = 0; i < kSuit; i++) {
-        for (int j = 0; j < kCardsPerSuit; j++) {
-          f[k][i * kCardsPerSuit + j] =
-              static_cast<float>(hands_[k].containsCard({i, j}));
-        }
-      }
+      hands_[k].cards().writeTo(f[k]);
     }
 
     return encoding;
   }
 
   void saveHandTo(int seatIdx, torch::Tensor& s) const {
-    auto f = s.accessor<float, 1>();
-
-    for (int i = 0; i < kSuit; i++) {
-      for (int j = 0; j < kCardsPerSuit; j++) {
-        f[i * kCardsPerSuit + j] =
-            static_cast<float>(hands_[seatIdx].containsCard({i, j}));
-      }
+    if (s.is_contiguous()) {
+      hands_[seatIdx].cards().writeTo(s.data_ptr<float>());
+    } else {
+      hands_[seatIdx].cards().writeTo(s.accessor<float, 1>());
     }
   }
 
   void saveAvailableBids(int currSeat, int tableIdx, torch::Tensor& s,
                          int offset) const {
+    const uint64_t mask = legalBidMask(currSeat, tableIdx);
+    if (s.is_contiguous()) {
+      expandBidMask(mask, kAction, s.data_ptr<float>() + offset);
+      return;
+    }
     auto f = s.accessor<float, 1>();
-    const Auction& currentAuction = auctions_[tableIdx];
-    // fill in available bids
-    // std::cout << "fill in avail" << std::endl;
-    // std::cout << "currentseat" << currentSeat_ << std::endl;
     for (int j = 0; j < kAction; j++) {
-      Bid tmpBid(j);
-      // tmpBid.fromIdx(j);
-      f[offset + j] = currentAuction.isBidLegal(tmpBid, currSeat) ? 1 : 0;
-      // std::cout << f[availStart + j];
+      f[offset + j] = (mask >> j) & 1;
     }
   }
 
@@ -571,21 +592,21 @@ class GameState {
   }
 
   void computeFeature2(int currSeat, int currTableIdx, torch::Tensor& s) const {
-    featureExtractor_.computeFeature(currSeat, currTableIdx, s);
+    FeatureExtractor(*this).computeFeature(currSeat, currTableIdx, s);
   }
 
   rela::TensorDict computeBaselineFeature2(int currSeat, int tableIdx) const {
-    return featureExtractorBaseline_.computeBaselineFeature2(currSeat,
-                                                             tableIdx);
+    return FeatureExtractorBaseline(*this).computeBaselineFeature2(
+        currSeat, tableIdx);
   }
 
   void computeFeatureOld(int currSeat, int currTableIdx,
                          torch::Tensor& s) const {
-    featureExtractorOld_.computeFeature(currSeat, currTableIdx, s);
+    FeatureExtractorOld(*this).computeFeature(currSeat, currTableIdx, s);
   }
 
   rela::TensorDict computePartnerInfo(int currSeat) const {
-    return featureExtractor_.computePartnerInfo(currSeat);
+    return FeatureExtractor(*this).computePartnerInfo(currSeat);
   }
 
   int getParScore() const {
@@ -721,16 +742,10 @@ class GameState {
   friend class FeatureExtractorOld;
 
  private:
-  FeatureExtractor featureExtractor_;
-  FeatureExtractorBaseline featureExtractorBaseline_;
-  FeatureExtractorOld featureExtractorOld_;
-
   std::array<int, kDeck> deal_;
   int dealer_;
   Vulnerability vul_;
   std::array<Hand, kPlayer> hands_;
-  std::array<std::array<int, kSuit>, kPlayer> suitStats_;
-  std::array<int, kPlayer> hcps_;
   float reward_;
   std::vector<Auction> auctions_;
   std::vector<PlayingSequence> playingSequences_;
@@ -744,6 +759,10 @@ class GameState {
 
   std::vector<int> rawScores_;
   std::vector<int> trick2Take_;
+
+  // mutable: a stale cache is rebuilt by the const computeFeature
+  mutable FeatureCache featureCache_;
+  bool verifyFeature_ = false;
 };
 
 }  // namespace bridge
@@ -60,7 +60,7 @@ void GameState2::resetBiddingStatus() {
 void GameState2::resetPlayingStatus() {
   playingHistory_.clear();
   playingHistory_.reserve(kDeckSize);
-  playedCards_ = 0;
+  playedCards_.clear();
   std::fill(currentTrick_.begin(), currentTrick_.end(), Card());
   leadingSuit_ = kNoSuit;
   winningSeat_ = kNoSeat;
@@ -116,14 +116,12 @@ bool GameState2::isPlayLegal(const Card& card) const {
 }
 
 uint64_t GameState2::legalPlayingActions() const {
-  uint64_t mask = 0;
-  for (int i = 0; i < kDeckSize; ++i) {
-    const Card card(i);
-    if (isPlayLegal(card)) {
-      mask |= (1LLU << i);
-    }
+  // Any card in hand, unless it can follow the leading suit.
+  const CardSet& cards = hands_.at(currentSeat_).cards();
+  if (leadingSuit_ == kNoSuit || !cards.suit(leadingSuit_)) {
+    return cards.bits();
   }
-  return mask;
+  return cards.suitBits(leadingSuit_);
 }
 
 void GameState2::biddingStep(int act) {
@@ -215,7 +213,7 @@ void GameState2::playingStep(int act) {
   }
   playingHistory_.emplace_back(card, currentSeat_);
   hands_[currentSeat_].remove(card);
-  playedCards_ |= (1LLU << card.index());
+  playedCards_.add(card);
   currentTrick_[currentSeat_] = card;
 
   if (playingHistory_.size() % kNumPlayers != 0) {
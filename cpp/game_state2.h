@@ -8,6 +8,7 @@
 
 #include "cpp/bid.h"
 #include "cpp/card.h"
+#include "cpp/card_set.h"
 #include "cpp/hand.h"
 #include "cpp/seat.h"
 #include "nlohmann/json.hpp"
@@ -168,7 +169,7 @@ class GameState2 {
     return playingHistory_;
   }
 
-  uint64_t playedCards() const { return playedCards_; }
+  uint64_t playedCards() const { return playedCards_.bits(); }
 
   const std::array<Card, kNumPlayers>& currentTrick() const {
     return currentTrick_;
@@ -241,7 +242,7 @@ class GameState2 {
   std::array<int, kNumTricks> winningSeats_;
 
   // Played cards mask.
-  uint64_t playedCards_ = 0;
+  CardSet playedCards_;
   // Current trick mask.
   std::array<Card, kNumPlayers> currentTrick_;
   int leadingSuit_ = kNoSuit;
@@ -4,12 +4,13 @@ namespace bridge {
 
 namespace {
 
-std::string maskToString(const std::array<uint32_t, kNumSuits>& mask) {
+std::string maskToString(const CardSet& mask) {
   std::string result;
   for (int i = 0; i < kNumSuits; ++i) {
     result += kSuitUnicode[i];
+    const uint32_t suit = mask.suit(i);
     for (int j = 0; j < kSuitSize; ++j) {
-      if (((mask[i] >> j) & 1) == 1) {
+      if (((suit >> j) & 1) == 1) {
         result.push_back(kIndexToCard[j]);
       }
     }
@@ -1,9 +1,9 @@
 #pragma once
 
-#include <array>
 #include <string>
 
 #include "cpp/card.h"
+#include "cpp/card_set.h"
 
 namespace bridge {
 
@@ -13,29 +13,31 @@ class Hand {
  public:
   Hand() { clear(); }
 
-  bool containsCard(const Card& card) const {
-    return ((mask_[card.suit()] >> card.value()) & 1) == 1;
-  }
+  bool containsCard(const Card& card) const { return mask_.contains(card); }
+
+  bool containsSuit(int suit) const { return mask_.suit(suit) != 0; }
+
+  // cards still in the hand
+  const CardSet& cards() const { return mask_; }
 
-  bool containsSuit(int suit) const { return mask_[suit] != 0; }
+  // cards dealt
+  const CardSet& originalCards() const { return hand_; }
 
   void clear() {
-    std::fill(hand_.begin(), hand_.end(), 0);
-    std::fill(mask_.begin(), mask_.end(), 0);
+    hand_.clear();
+    mask_.clear();
   }
 
   bool add(const Card& card) {
     const bool ret = !containsCard(card);
-    hand_[card.suit()] |= (1U << card.value());
-    mask_[card.suit()] |= (1U << card.value());
+    hand_.add(card);
+    mask_.add(card);
     return ret;
   }
 
   bool remove(const Card& card) {
     const bool ret = containsCard(card);
-    if (ret) {
-      mask_[card.suit()] ^= (1U << card.value());
-    }
+    mask_.remove(card);
     return ret;
   }
 
@@ -44,10 +46,10 @@ class Hand {
   std::string originalHandString() const;
 
  private:
-  // mask for original cards in each suit.
-  std::array<uint32_t, kNumSuits> hand_;
-  // mask for availale cards in each suit.
-  std::array<uint32_t, kNumSuits> mask_;
+  // original cards.
+  CardSet hand_;
+  // availale cards.
+  CardSet mask_;
 };
 
 }  // namespace bridge
@@ -30,7 +30,7 @@ int PlayingSequence::makePlay(const Card& c, int seat) {
   }
 
   ++numCardsPlayed_;
-  cardsPlayed_[c.index()] = numCardsPlayed_;
+  cardsPlayed_.add(c);
 
   int next_seat = NEXT_SEAT(seat);
   if (isFirstTurn()) {
@@ -7,6 +7,7 @@
 
 #include "bridge_common.h"
 #include "card.h"
+#include "card_set.h"
 #include "hand.h"
 
 namespace bridge {
@@ -23,16 +24,16 @@ class PlayingSequence {
 
   bool isFirstTurn() const { return numCardsPlayed_ % kPlayer == 0; }
 
-  const std::array<int, kDeck>& cardsPlayed() const { return cardsPlayed_; }
+  const CardSet& cardsPlayed() const { return cardsPlayed_; }
 
-  void clear() { std::fill(cardsPlayed_.begin(), cardsPlayed_.end(), 0); }
+  void clear() { cardsPlayed_.clear(); }
 
   int makePlay(const Card& c, int seat);
 
  private:
   const int trump_ = NO_SUIT;
 
-  std::array<int, kDeck> cardsPlayed_;
+  CardSet cardsPlayed_;
   int numCardsPlayed_ = 0;
 
   int currentSuit_ = NO_SUIT;
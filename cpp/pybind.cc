@@ -13,10 +13,29 @@
 #include "cpp/duplicate_bridge_env.h"
 #include "cpp/greedy_play_actor.h"
 #include "cpp/random_actor.h"
+#include "rela/vector_env.h"
 
 namespace py = pybind11;
 // using namespace bridge;
 
+namespace {
+
+template <class E>
+void defineVectorEnv(py::module& m, const char* name) {
+  using VectorEnv = rela::VectorEnv<E>;
+  py::class_<VectorEnv, std::shared_ptr<VectorEnv>>(m, name)
+      .def(py::init<std::vector<std::shared_ptr<E>>>())
+      .def("size", &VectorEnv::size)
+      .def("reset", [](VectorEnv& v) { return v.reset(); })
+      .def("reset", [](VectorEnv& v, int i) { return v.reset(i); })
+      .def("terminated", &VectorEnv::terminated)
+      .def("player_idx", &VectorEnv::playerIdx)
+      .def("feature", &VectorEnv::feature)
+      .def("step", &VectorEnv::step);
+}
+
+}  // namespace
+
 PYBIND11_MODULE(bridge, m) {
   py::class_<DBInterface, std::shared_ptr<DBInterface>>(m, "DBInterface")
       .def(py::init<const std::string&, const std::string&, int>())
@@ -77,6 +96,9 @@ PYBIND11_MODULE(bridge, m) {
   // .def("get_episode_reward", &bridge::BridgeEnv::getEpisodeReward)
   // .def("get_rewards", &bridge::DuplicateBridgeEnv::getRewards);
 
+  defineVectorEnv<bridge::BridgeEnv>(m, "BridgeVectorEnv");
+  defineVectorEnv<bridge::DuplicateBridgeEnv>(m, "DuplicateBridgeVectorEnv");
+
   py::class_<AllPassActor2, rela::Actor2, std::shared_ptr<AllPassActor2>>(
       m, "AllPassActor2")
       .def(py::init<>())
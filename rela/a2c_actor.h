@@ -8,6 +8,7 @@
 #include "rela/actor2.h"
 #include "rela/model.h"
 #include "rela/prioritized_replay2.h"
+#include "rela/tensor_record.h"
 #include "rela/utils.h"
 
 namespace rela {
@@ -24,9 +25,15 @@ class MultiStepTransitionBuffer2 {
 
   void push(TensorDict& dicts) {
     assert((int)history_.size() <= multiStep_);
-    utils::assertKeyExists(dicts, {"reward", "terminal"});
 
-    history_.push_back(dicts);
+    // one lookup per field; the schema only changes with the dict's fields
+    TensorRecord record;
+    if (schema_ == nullptr ||
+        !TensorRecord::tryFromTensorDict(schema_, dicts, &record)) {
+      setSchema(RecordSchema::fromTensorDict(dicts));
+      record = TensorRecord::fromTensorDict(schema_, dicts);
+    }
+    history_.push_back(std::move(record));
   }
 
   size_t size() {
@@ -47,19 +54,29 @@ class MultiStepTransitionBuffer2 {
   Transition popTransition() {
     assert(canPop());
 
-    TensorDict d = history_.front();
+    const auto& front = history_.front();
+    TensorDict d;
+    if (getTrajNextObs_) {
+      // This is the next obs after multiStep_ 
+      d.reserve(front.size() + history_.back().size() + 1);
+      addPrefixed(d, front, 0);
+      addPrefixed(d, history_.back(), 1);
+    } else {
+      d = front.toTensorDict();
+    }
 
     if (calcCumulativeReward_) {
       // calculate cumulated rewards.
       // history_[multiStep_] is the most recent state.
-      torch::Tensor reward = history_[multiStep_]["v"].clone();
+      const auto& last = history_[multiStep_];
+      torch::Tensor reward = last[fields(last).v].clone();
 
       for (int step = multiStep_ - 1; step >= 0; step--) {
-        // [TODO] suppose we shouldn't change h.
-        auto& h = history_[step];
-        const auto& r = h["reward"];
+        const auto& h = history_[step];
+        const auto& ids = fields(h);
+        const auto& r = h[ids.reward];
 
-        if (h["terminal"].item<bool>()) {
+        if (h[ids.terminal].item<bool>()) {
           // Has terminal. so we reset the reward.
           reward = r;
         } else {
@@ -67,12 +84,7 @@ class MultiStepTransitionBuffer2 {
         }
       }
 
-      d["R"] = reward;
-    }
-
-    if (getTrajNextObs_) {
-      // This is the next obs after multiStep_ 
-      d = utils::combineTensorDictArgs(d, history_.back());
+      d[getTrajNextObs_ ? "0.R" : "R"] = reward;
     }
 
     history_.pop_front();
@@ -84,12 +96,70 @@ class MultiStepTransitionBuffer2 {
   }
 
  private:
+  struct FieldIds {
+    int reward = -1;
+    int terminal = -1;
+    int v = -1;
+    // names in the combined dict of getTrajNextObs_, "0.x" and "1.x"
+    std::vector<std::string> prefixed[2];
+  };
+
+  void setSchema(std::shared_ptr<const RecordSchema> schema) {
+    schema_ = std::move(schema);
+    ids_ = resolve(*schema_);
+  }
+
+  FieldIds resolve(const RecordSchema& schema) const {
+    FieldIds ids;
+    ids.reward = schema.fieldId("reward");
+    ids.terminal = schema.fieldId("terminal");
+    RELA_CHECK(ids.reward >= 0 && ids.terminal >= 0,
+               "transitions need \"reward\" and \"terminal\"");
+    if (calcCumulativeReward_) {
+      ids.v = schema.fieldId("v");
+      RELA_CHECK(ids.v >= 0, "cumulative reward needs \"v\"");
+    }
+    if (getTrajNextObs_) {
+      for (int k = 0; k < 2; ++k) {
+        for (int i = 0; i < schema.size(); ++i) {
+          ids.prefixed[k].push_back(std::to_string(k) + "." + schema.name(i));
+        }
+      }
+    }
+    return ids;
+  }
+
+  // steps pushed before the last schema change use a second cached entry
+  const FieldIds& fields(const TensorRecord& h) {
+    if (h.schemaPtr() == schema_) {
+      return ids_;
+    }
+    if (h.schemaPtr() != oldSchema_) {
+      oldSchema_ = h.schemaPtr();
+      oldIds_ = resolve(*oldSchema_);
+    }
+    return oldIds_;
+  }
+
+  void addPrefixed(TensorDict& d, const TensorRecord& h, int k) {
+    const auto& ids = fields(h);
+    for (int i = 0; i < h.size(); ++i) {
+      if (h[i].defined()) {
+        d[ids.prefixed[k][i]] = h[i];
+      }
+    }
+  }
+
   const int multiStep_;
   const float gamma_;
   const bool calcCumulativeReward_;
   const bool getTrajNextObs_;
 
-  std::deque<TensorDict> history_;
+  std::shared_ptr<const RecordSchema> schema_;
+  FieldIds ids_;
+  std::shared_ptr<const RecordSchema> oldSchema_;
+  FieldIds oldIds_;
+  std::deque<TensorRecord> history_;
 };
 
 class A2CActor : public Actor2 {
@@ -116,6 +186,11 @@ class A2CActor : public Actor2 {
     return models_->call("act", obs);
   }
 
+  TensorDictFuture actInPlace(const std::vector<std::string>& fields,
+                              const RowWriter& write) override {
+    return models_->callInPlace("act", fields, write);
+  }
+
   void sendExperience(TensorDict& d) override {
     if (replayBuffer_ == nullptr) {
       return;
@@ -130,10 +205,13 @@ class A2CActor : public Actor2 {
     assert(!transition.empty());
     // utils::tensorDictPrint(transition.d);
 
-    auto priorityFuture = models_->call("compute_priority", transition.d);
-    addFuture([this, transition, priorityFuture]() {
-      auto priority = priorityFuture();
-      replayBuffer_->add(transition, priority["priority"].item<float>());
+    if (priorityField_ < 0) {
+      priorityField_ = models_->fieldId("compute_priority", "priority");
+    }
+    auto priorityReply = models_->callReply("compute_priority", transition.d);
+    addFuture([this, transition, priorityReply]() {
+      auto priority = priorityReply.get(priorityField_);
+      replayBuffer_->add(transition, priority.item<float>());
     });
 
     /*
@@ -148,6 +226,7 @@ class A2CActor : public Actor2 {
   MultiStepTransitionBuffer2 transitionBuffer_;
   std::shared_ptr<PrioritizedReplay2> replayBuffer_;
   std::atomic<int> numAct_;
+  int priorityField_ = -1;
 };
 
 }  // namespace rela
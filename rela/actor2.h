@@ -2,38 +2,12 @@
 
 #pragma once
 
+#include "rela/future_executor.h"
 #include "rela/types.h"
 #include <functional>
 
 namespace rela {
 
-class FutureExecutor {
- public:
-  void addFuture(std::function<void()> f) {
-    futures_.push_back(f);
-  }
-
-  void execute()  {
-    int count = 0;
-    while (! futures_.empty()) {
-      auto f = futures_.front();
-      f();
-      futures_.pop_front();
-      count ++;
-      if (count > 2000000) {
-        std::cout << "FutureExecutor::execute(): counter exceeded. Something wrong!" << std::endl;
-      }
-
-      // [TODO]: This is needed if we use static batching 
-      // If there is new request then:
-      // for (auto &v : models_) { v->processRequest(); }
-    }
-  }
-
- private:
-  std::deque<std::function<void()>> futures_;
-};
-
 class Actor2 {
  public:
   Actor2() = default;
@@ -46,6 +20,22 @@ class Actor2 {
   }
 
   virtual TensorDictFuture act(TensorDict&) = 0;
+
+  // fills row `row` of every input field of the batch
+  using RowWriter = std::function<void(const TensorDict& batch, int row)>;
+
+  // Same as act() on the input that write produces, but write fills the
+  // batcher slot directly; fields are the ones it fills. nullptr if the
+  // actor cannot do that (yet), the caller then falls back to act().
+  virtual TensorDictFuture actInPlace(const std::vector<std::string>&,
+                                      const RowWriter&) {
+    return nullptr;
+  }
+  // Called before act() / actInPlace() when the env gives its legal actions
+  // as a bitmask (see Env::legalActionBits), so that the actor can mask or
+  // sample without reading "legal_move" back from the input tensors.
+  virtual void setLegalActions(uint64_t) { }
+
   // Called if the associated environment send a terminal signal.  
   // Useful if the actor has internal state. 
   virtual void setTerminal() { }
@@ -57,10 +47,10 @@ class Actor2 {
   std::shared_ptr<FutureExecutor> executor_;
 
  protected:
-  void addFuture(std::function<void()> f) {
+  template <class F>
+  void addFuture(F&& f) {
     assert(executor_ != nullptr);
-    assert(f != nullptr);
-    executor_->addFuture(f);
+    executor_->addFuture(std::forward<F>(f));
   }
 };
 }
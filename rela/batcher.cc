@@ -2,14 +2,17 @@
 
 namespace rela {
 
-TensorDict allocateBatchStorage(const TensorDict& data, int size) {
+TensorDict allocateBatchStorage(const TensorDict& data, int size,
+                                bool pinMemory) {
   TensorDict storage;
   for (const auto& kv : data) {
     const auto& t = kv.second.sizes();
     std::vector<int64_t> sizes(t.size() + 1);
     sizes[0] = size;
     std::copy(t.cbegin(), t.cend(), sizes.begin() + 1);
-    storage[kv.first] = torch::zeros(sizes, kv.second.dtype());
+    storage[kv.first] = torch::zeros(
+        sizes,
+        torch::TensorOptions().dtype(kv.second.dtype()).pinned_memory(pinMemory));
   }
   return storage;
 }
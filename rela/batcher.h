@@ -6,18 +6,30 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <memory>
+#include <stdexcept>
+#include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
-#include <boost/fiber/condition_variable.hpp>
-#include <boost/fiber/mutex.hpp>
+#include <condition_variable>
+#include <mutex>
 
+#include "rela/logging.h"
+#include "rela/metrics.h"
+#include "rela/topology.h"
 #include "rela/utils.h"
+#include "rela/wait_policy.h"
 
 namespace rela {
 
-TensorDict allocateBatchStorage(const TensorDict& data, int size);
+TensorDict allocateBatchStorage(const TensorDict& data, int size,
+                                bool pinMemory = false);
 // TensorDict allocateBatchStorage(const TensorDict& data, int size) {
 //   TensorDict storage;
 //   for (const auto& kv : data) {
@@ -36,66 +48,213 @@ TensorDict allocateBatchStorage(const TensorDict& data, int size);
 //   return storage;
 // }
 
+// Field name -> integer id of the replies coming out of one Batcher. Ids are
+// handed out on first use and never change, so callers resolve the names
+// they need once and then index replies without hashing strings.
+class ReplySchema {
+ public:
+  int fieldId(const std::string& name) {
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+    const int id = (int)names_.size();
+    ids_.emplace(name, id);
+    names_.push_back(name);
+    return id;
+  }
+
+  int size() {
+    std::lock_guard<std::mutex> lk(m_);
+    return (int)names_.size();
+  }
+
+ private:
+  std::mutex m_;
+  std::unordered_map<std::string, int> ids_;
+  std::vector<std::string> names_;
+};
+
 class FutureReply {
  public:
-  FutureReply(int batchdim)
+  FutureReply(int batchdim, std::shared_ptr<ReplySchema> schema = nullptr)
       : batchdim_(batchdim)
+      , schema_(std::move(schema))
       , ready_(false) {
   }
 
+  void wait() {
+    if (ready_.load(std::memory_order_acquire)) {
+      return;
+    }
+    // time actors spend queued behind the batch and its forward
+    static const metrics::Histogram waitUs("batcher.reply_wait_us");
+    metrics::ScopedTimer timer(waitUs);
+    waiter_.wait([this] { return ready_.load(std::memory_order_acquire); });
+  }
+
   TensorDict get(int slot) {
     // std::cout << "getting slot: " << slot << std::endl;
-    std::unique_lock<std::mutex> lk(mReady_);
-    cvReady_.wait(lk, [this] { return ready_; });
-    lk.unlock();
+    wait();
 
     TensorDict e;
+    e.reserve(data_.size());
     for (const auto& kv : data_) {
-      assert(slot >= 0 && slot < kv.second.size(0));
-      e[kv.first] = kv.second.narrow(batchdim_, slot, 1).squeeze(batchdim_);
+      assert(slot >= 0 && slot < kv.second.size(batchdim_));
+      e.emplace(kv.first, kv.second.select(batchdim_, slot));
       // std::cout << kv.first << "\n" << e[kv.first] << std::endl;
     }
     return e;
     // return data_[slot];
   }
 
+  // rows [slot, slot + n) of every field, for callers that sent n rows at
+  // once through Batcher::send(t, n, &slot).
+  TensorDict getRows(int slot, int n) {
+    wait();
+
+    TensorDict e;
+    e.reserve(data_.size());
+    for (const auto& kv : data_) {
+      assert(slot >= 0 && slot + n <= kv.second.size(batchdim_));
+      e.emplace(kv.first, kv.second.narrow(batchdim_, slot, n));
+    }
+    return e;
+  }
+
+  // view of one field for one slot, fieldId comes from the Batcher's schema.
+  torch::Tensor get(int slot, int fieldId) {
+    wait();
+    assert(fieldId >= 0);
+    if (fieldId >= (int)fields_.size() || !fields_[fieldId].defined()) {
+      throw std::runtime_error("reply has no field with id " +
+                               std::to_string(fieldId));
+    }
+    const auto& t = fields_[fieldId];
+    assert(slot >= 0 && slot < t.size(batchdim_));
+    return t.select(batchdim_, slot);
+  }
+
   void set(TensorDict&& t) {
     // assert(t.device().is_cpu());
-    {
-      std::lock_guard<std::mutex> lk(mReady_);
-      ready_ = true;
-      data_ = std::move(t);
+    if (schema_ != nullptr) {
+      // resolve names once per batch rather than once per consumer
+      for (const auto& kv : t) {
+        const int id = schema_->fieldId(kv.first);
+        if (id >= (int)fields_.size()) {
+          fields_.resize(id + 1);
+        }
+        fields_[id] = kv.second;
+      }
     }
-    cvReady_.notify_all();
+    data_ = std::move(t);
+    ready_.store(true, std::memory_order_release);
+    // only the callers with a slot in this batch wait on this reply
+    waiter_.notifyAll();
   }
 
  private:
   // no need for protection, only set() can set it
   // torch::Tensor data_;
   TensorDict data_;
+  std::vector<torch::Tensor> fields_;
 
-  std::mutex mReady_;
   const int batchdim_;
-  bool ready_;
-  boost::fibers::condition_variable_any cvReady_;
+  const std::shared_ptr<ReplySchema> schema_;
+  std::atomic<bool> ready_;
+  WaitPolicy waiter_;
+};
+
+// One caller's view into a batched reply: the FutureReply plus the slot the
+// caller was given by Batcher::send.
+class ReplyHandle {
+ public:
+  ReplyHandle() = default;
+
+  ReplyHandle(std::shared_ptr<FutureReply> reply, int slot)
+      : reply_(std::move(reply))
+      , slot_(slot) {
+  }
+
+  bool empty() const {
+    return reply_ == nullptr;
+  }
+
+  void wait() const {
+    reply_->wait();
+  }
+
+  torch::Tensor get(int fieldId) const {
+    return reply_->get(slot_, fieldId);
+  }
+
+  TensorDict toTensorDict() const {
+    return reply_->get(slot_);
+  }
+
+ private:
+  std::shared_ptr<FutureReply> reply_;
+  int slot_ = -1;
 };
 
 class Batcher {
  public:
-  Batcher(int batchsize, int batchdim = 0)
+  // maxWaitUs > 0 lets get() hold a partially filled batch for up to
+  // maxWaitUs microseconds (counted from when it sees the first request)
+  // waiting for more writers. 0 keeps the old behavior of flushing as soon as
+  // no write is in flight.
+  //
+  // numBuffers is the depth of the batch ring. A full batch is sealed by its
+  // last writer and filling moves on to the next free buffer, so writers only
+  // wait when all numBuffers batches are queued or being forwarded.
+  //
+  // pinMemory allocates the batch buffers in page-locked memory so the
+  // forward can upload them to a cuda device without blocking.
+  //
+  // numaNode >= 0 moves the batch buffers to that NUMA node once they are
+  // allocated. Batchers serving the same call, e.g. one per node, pass the
+  // same schema so field ids resolved on one are valid on all of them.
+  Batcher(int batchsize, int batchdim = 0, int maxWaitUs = 0,
+          int numBuffers = 2, bool pinMemory = false, int numaNode = -1,
+          std::shared_ptr<ReplySchema> schema = nullptr)
       : batchsize_(batchsize)
       , batchdim_(batchdim)
-      , nextSlot_(0)
-      , numActiveWrite_(0)
-      // , buffer_(torch::zeros({batchsize, dim}))
-      , fillingReply_(std::make_shared<FutureReply>(batchdim))
-      , filledReply_(nullptr) {
+      , maxWaitUs_(maxWaitUs)
+      , pinMemory_(pinMemory)
+      , numaNode_(numaNode)
+      , schema_(schema != nullptr ? std::move(schema)
+                                  : std::make_shared<ReplySchema>())
+      , slotState_(0)
+      , buffers_(numBuffers)
+      , fillIdx_(0) {
+    assert(batchsize_ > 0);
+    assert(numBuffers >= 2);
+    buffers_[fillIdx_].reply =
+        std::make_shared<FutureReply>(batchdim_, schema_);
   }
 
   ~Batcher() {
     exit();
   }
 
+  int numBuffers() const {
+    return (int)buffers_.size();
+  }
+
+  int batchsize() const {
+    return batchsize_;
+  }
+
+  // id of a reply field, for ReplyHandle::get / FutureReply::get(slot, id)
+  int fieldId(const std::string& name) {
+    return schema_->fieldId(name);
+  }
+
+  const std::shared_ptr<ReplySchema>& schema() const {
+    return schema_;
+  }
+
   void exit() {
     {
       std::unique_lock<std::mutex> lk(mNextSlot_);
@@ -104,154 +263,357 @@ class Batcher {
     cvGetBatch_.notify_all();
   }
 
-  // send data into batcher
-  std::shared_ptr<FutureReply> send(const TensorDict& t, int* slot) {
-    std::unique_lock<std::mutex> lk(mNextSlot_);
-
-    // init buffer
-    if (fillingBuffer_.empty()) {
-      assert(filledBuffer_.empty());
-      fillingBuffer_ = allocateBatchStorage(t, batchsize_);
-      filledBuffer_ = allocateBatchStorage(t, batchsize_);
+  // While draining, get() hands out partial batches right away instead of
+  // holding them for maxWaitUs, so loops that are about to pause are not
+  // kept waiting for writers that will not come.
+  void setDraining(bool draining) {
+    {
+      std::lock_guard<std::mutex> lk(mNextSlot_);
+      draining_ = draining;
     }
+    cvGetBatch_.notify_all();
+  }
 
-    assert(nextSlot_ <= batchsize_);
-    // wait if current batch is full and not extracted
-    cvNextSlot_.wait(lk, [this] { return nextSlot_ < batchsize_; });
-
-    *slot = nextSlot_;
-    ++nextSlot_;
-    ++numActiveWrite_;
-    lk.unlock();
+  // send data into batcher
+  std::shared_ptr<FutureReply> send(const TensorDict& t, int* slot) {
+    initBuffers(t);
+    *slot = reserveSlot(1);
 
+    // the filling buffer cannot be sealed while we hold a writer count, so
+    // fillIdx_ and its reply are stable until releaseSlot().
+    auto& buffer = buffers_[fillIdx_];
     // this will copy
     if (batchdim_ == 0) {
       for (const auto& kv : t) {
-        fillingBuffer_[kv.first][*slot] = kv.second;
+        buffer.data[kv.first][*slot] = kv.second;
       }
     } else {
       for (const auto& kv : t) {
-        auto slice = fillingBuffer_[kv.first].narrow(batchdim_, *slot, 1);
+        auto slice = buffer.data[kv.first].narrow(batchdim_, *slot, 1);
         slice.copy_(kv.second.unsqueeze(batchdim_));
       }
     }
 
-    // batch has not been extracted yet
-    assert(numActiveWrite_ > 0);
-    assert(fillingReply_ != nullptr);
-    auto reply = fillingReply_;
-    lk.lock();
-    --numActiveWrite_;
-    lk.unlock();
-    if (numActiveWrite_ == 0) {
-      cvGetBatch_.notify_one();
+    assert(buffer.reply != nullptr);
+    auto reply = buffer.reply;
+    releaseSlot();
+    return reply;
+  }
+
+  // Send n rows at once, e.g. from a VectorEnv: every field of t has n as
+  // its leading dim. The rows get the consecutive slots [*slot, *slot + n)
+  // of one batch, read back with FutureReply::getRows(*slot, n).
+  std::shared_ptr<FutureReply> send(const TensorDict& t, int n, int* slot) {
+    RELA_CHECK_EQ(batchdim_, 0, "multi row send needs batchdim 0");
+    RELA_CHECK(n >= 1 && n <= batchsize_, n, " rows do not fit batchsize ",
+               batchsize_);
+    if (!initialized_.load(std::memory_order_acquire)) {
+      TensorDict row;
+      for (const auto& kv : t) {
+        row.emplace(kv.first, kv.second[0]);
+      }
+      initBuffers(row);
+    }
+    *slot = reserveSlot(n);
+
+    auto& buffer = buffers_[fillIdx_];
+    for (const auto& kv : t) {
+      assert(kv.second.size(0) == n);
+      buffer.data[kv.first].narrow(0, *slot, n).copy_(kv.second);
     }
+
+    assert(buffer.reply != nullptr);
+    auto reply = buffer.reply;
+    releaseSlot();
     return reply;
   }
 
-  // get batch input from batcher
-  TensorDict get() {
+  // Reserve a slot and let write(batch, row) fill row `row` of every field
+  // of the filling buffer, e.g. through Env::writeFeature, so the input is
+  // never built as tensors of its own. The buffers are reused: write must
+  // overwrite the whole row. fields are the ones write fills. Returns
+  // nullptr, so that the caller falls back to send(), while the buffers are
+  // not allocated, i.e. before a first send() has told their shapes, or
+  // when fields are not exactly the batch's.
+  template <class Writer>
+  std::shared_ptr<FutureReply> sendInPlace(
+      const std::vector<std::string>& fields, const Writer& write, int* slot) {
+    RELA_CHECK_EQ(batchdim_, 0, "in place send needs batchdim 0");
+    if (!initialized_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    // checked before reserving: a failing writer must not hold a slot
+    const TensorDict& fieldSet = buffers_[0].data;
+    if (fields.size() != fieldSet.size()) {
+      return nullptr;
+    }
+    for (const auto& field : fields) {
+      if (!fieldSet.count(field)) {
+        return nullptr;
+      }
+    }
+    *slot = reserveSlot(1);
+
+    auto& buffer = buffers_[fillIdx_];
+    try {
+      write(static_cast<const TensorDict&>(buffer.data), *slot);
+    } catch (...) {
+      // the row is left as is, nobody will read its reply; the batch must
+      // still be able to seal
+      releaseSlot();
+      throw;
+    }
+
+    assert(buffer.reply != nullptr);
+    auto reply = buffer.reply;
+    releaseSlot();
+    return reply;
+  }
+
+  // get batch input from batcher, the reply must be given back through
+  // set(batchId, ...). Several batches can be in flight at the same time.
+  TensorDict get(int* batchId) {
     std::unique_lock<std::mutex> lk(mNextSlot_);
-    cvGetBatch_.wait(lk, [this] {
-      return (nextSlot_ > 0 && numActiveWrite_ == 0) || exit_;
-    });
+    cvGetBatch_.wait(
+        lk, [this] { return !ready_.empty() || hasPartialBatch() || exit_; });
+
+    if (ready_.empty() && maxWaitUs_ > 0 && !exit_ && !draining_) {
+      // hold the batch open until it is full or the deadline passes.
+      auto deadline = std::chrono::steady_clock::now() +
+                      std::chrono::microseconds(maxWaitUs_);
+      cvGetBatch_.wait_until(lk, deadline, [this] {
+        return !ready_.empty() || exit_ || draining_;
+      });
+    }
+
+    // nothing sealed yet: seal the partial batch ourselves.
+    while (ready_.empty() && !exit_) {
+      uint64_t s = slotState_.load(std::memory_order_acquire);
+      if (!hasPartialBatch(s)) {
+        cvGetBatch_.wait(lk, [this] {
+          return !ready_.empty() || hasPartialBatch() || exit_;
+        });
+        continue;
+      }
+      if (slotState_.compare_exchange_weak(s, kSealed,
+                                           std::memory_order_acq_rel)) {
+        sealLocked(slotOf(s));
+      }
+    }
 
     if (exit_) {
       return TensorDict();
     }
 
-    // TensorDict batch;
-    // for (const auto& kv : buffer_) {
-    //   batch[kv.first] = kv.second.narrow_copy(batchdim_, 0, nextSlot_).contiguous();
-    // }
-    int bsize = nextSlot_;
-    nextSlot_ = 0;
-    // assert previous reply has been handled
-    assert(filledReply_ == nullptr);
-    std::swap(fillingBuffer_, filledBuffer_);
-    std::swap(fillingReply_, filledReply_);
-    fillingReply_ = std::make_shared<FutureReply>(batchdim_);
-
-    // assert currentReply has been handled
-    // assert(currentReply_ == nullptr);
-    // currentreply_ = std::move(nextReply_);
-    // nextReply_ = std::make_shared<FutureReply>(batchdim_);
-
+    const auto entry = ready_.front();
+    ready_.pop_front();
+    inFlight_.push_back(entry.first);
+    *batchId = entry.first;
+    const int bsize = entry.second;
     lk.unlock();
-    cvNextSlot_.notify_all();
+    // sealLocked() may have moved filling to a new buffer.
+    slotFree_.notifyAll();
 
+    // the buffer is not reused before set(batchId, ...), so a view is enough.
     TensorDict batch;
-    for (const auto& kv : filledBuffer_) {
+    for (const auto& kv : buffers_[*batchId].data) {
       batch[kv.first] = kv.second.narrow(0, 0, bsize).contiguous();
       // batch[kv.first] = kv.second.narrow_copy(0, 0, batchsize_).contiguous();
     }
-
-    sumBatchsize_ += bsize;
-    batchCount_ += 1;
-    if (batchCount_ % 5000 == 0) {
-      /*
-      if (sumBatchsize_ / batchCount_ > 100) {
-        std::cout << ">>>>>>>>>>>>>>>.batchcount: " << (int64_t)this << std::endl;
-        std::cout << sumBatchsize_ / (float)batchCount_ << std::endl;
-        std::cout << ">>>>>>>>>>>>>>>>>>>>>>>>>>>"<< std::endl;
-      }
-      */
-      sumBatchsize_ = 0;
-      batchCount_ = 0;
-    }
-
     return batch;
   }
 
-  // set batch reply for batcher
-  void set(TensorDict&& t) {
-    // auto start = high_resolution_clock::now();
+  TensorDict get() {
+    int batchId = -1;
+    return get(&batchId);
+  }
 
+  // set batch reply for batcher
+  void set(int batchId, TensorDict&& t) {
     for (const auto& kv : t) {
       assert(kv.second.device().is_cpu());
     }
-    // assert(currentReply_ != nullptr);
-    filledReply_->set(std::move(t));
-    filledReply_ = nullptr;
-
-    // auto stop = high_resolution_clock::now();
-    // auto duration = duration_cast<microseconds>(stop - start);
-    // timer_["set"] += duration.count();
-    // counter_ += 1;
-    // if (counter_ % 1000 == 0)  {
-    //   std::cout << "===============" << std::endl;
-    //   for (auto& kv : timer_) {
-    //     std::cout << kv.first << ": " << kv.second / 1000 << std::endl;
-    //     timer_[kv.first] = 0;
-    //   }
-    //   std::cout << "===========" << std::endl;
-    // }
+    assert(batchId >= 0 && batchId < (int)buffers_.size());
+    buffers_[batchId].reply->set(std::move(t));
+
+    bool advanced = false;
+    {
+      std::lock_guard<std::mutex> lk(mNextSlot_);
+      auto it = std::find(inFlight_.begin(), inFlight_.end(), batchId);
+      assert(it != inFlight_.end());
+      inFlight_.erase(it);
+      buffers_[batchId].busy = false;
+      // filling was stalled on a sealed batch because the ring was full.
+      if (slotState_.load(std::memory_order_acquire) == kSealed) {
+        advanced = advanceLocked();
+      }
+    }
+    if (advanced) {
+      slotFree_.notifyAll();
+    }
+  }
+
+  // set reply of the oldest batch in flight
+  void set(TensorDict&& t) {
+    int batchId = -1;
+    {
+      std::lock_guard<std::mutex> lk(mNextSlot_);
+      assert(!inFlight_.empty());
+      batchId = inFlight_.front();
+    }
+    set(batchId, std::move(t));
   }
 
   // hack: public so that they can coordinate thread exit
   bool exit_ = false;
-  boost::fibers::condition_variable_any cvGetBatch_;
+  bool draining_ = false;
+  // the consumer side is the forward thread(s), always OS threads.
+  std::condition_variable cvGetBatch_;
   std::mutex mNextSlot_;
 
  private:
-  const int batchsize_;
-  const int batchdim_;
+  struct BatchBuffer {
+    TensorDict data;
+    std::shared_ptr<FutureReply> reply;
+    // sealed and waiting for / under forward, cannot be refilled.
+    bool busy = false;
+  };
+
+  // slotState_ packs the next free slot (high 32 bits) and the number of
+  // writers still copying into the filling buffer (low 32 bits), so a writer
+  // reserves its slot with a single CAS instead of taking mNextSlot_.
+  // kSealed marks a filling buffer that has been handed to the ready queue
+  // but could not be replaced yet because every buffer is busy.
+  static constexpr uint64_t kOneSlot = uint64_t(1) << 32;
+  static constexpr uint64_t kWriterMask = kOneSlot - 1;
+  static constexpr uint64_t kSealed = ~kWriterMask;
+
+  static uint64_t packState(int slot, int writers) {
+    return (uint64_t(slot) << 32) | uint64_t(writers);
+  }
+  static int slotOf(uint64_t s) {
+    return int(s >> 32);
+  }
+  static int writersOf(uint64_t s) {
+    return int(s & kWriterMask);
+  }
 
-  int sumBatchsize_ = 0;
-  int batchCount_ = 0;
+  bool hasPartialBatch(uint64_t s) const {
+    return s != kSealed && slotOf(s) > 0 && writersOf(s) == 0;
+  }
+  bool hasPartialBatch() const {
+    return hasPartialBatch(slotState_.load(std::memory_order_acquire));
+  }
 
-  int nextSlot_;
-  int numActiveWrite_;
-  boost::fibers::condition_variable_any cvNextSlot_;
+  // allocate the batch buffers, shaped after one row of input
+  void initBuffers(const TensorDict& row) {
+    if (initialized_.load(std::memory_order_acquire)) {
+      return;
+    }
+    std::lock_guard<std::mutex> lk(mNextSlot_);
+    if (buffers_[0].data.empty()) {
+      for (auto& b : buffers_) {
+        b.data = allocateBatchStorage(row, batchsize_, pinMemory_);
+        if (numaNode_ >= 0) {
+          for (const auto& kv : b.data) {
+            bindMemoryToNode(kv.second.data_ptr(),
+                             kv.second.numel() * kv.second.element_size(),
+                             numaNode_);
+          }
+        }
+      }
+    }
+    initialized_.store(true, std::memory_order_release);
+  }
 
-  TensorDict fillingBuffer_;
-  std::shared_ptr<FutureReply> fillingReply_;
+  // n consecutive slots of the filling buffer. If they do not fit we wait
+  // for get() to take the partial batch and filling to move on.
+  int reserveSlot(int n) {
+    uint64_t s = slotState_.load(std::memory_order_acquire);
+    while (true) {
+      if (s != kSealed && slotOf(s) + n <= batchsize_) {
+        if (slotState_.compare_exchange_weak(s, s + n * kOneSlot + 1,
+                                             std::memory_order_acq_rel)) {
+          return slotOf(s);
+        }
+        continue;
+      }
+      // wait if the whole ring is full and not extracted
+      slotFree_.wait([this, n] {
+        const uint64_t cur = slotState_.load(std::memory_order_acquire);
+        return cur != kSealed && slotOf(cur) + n <= batchsize_;
+      });
+      s = slotState_.load(std::memory_order_acquire);
+    }
+  }
+
+  void releaseSlot() {
+    const uint64_t prev = slotState_.fetch_sub(1, std::memory_order_acq_rel);
+    assert(writersOf(prev) > 0);
+    if (writersOf(prev) != 1) {
+      return;
+    }
+
+    bool advanced = false;
+    {
+      // take the lock so the wakeup cannot slip in between get() checking
+      // its predicate and going to sleep.
+      std::lock_guard<std::mutex> lk(mNextSlot_);
+      uint64_t full = packState(batchsize_, 0);
+      if (slotOf(prev) == batchsize_ &&
+          slotState_.compare_exchange_strong(full, kSealed,
+                                             std::memory_order_acq_rel)) {
+        advanced = sealLocked(batchsize_);
+      }
+    }
+    cvGetBatch_.notify_one();
+    if (advanced) {
+      slotFree_.notifyAll();
+    }
+  }
+
+  // queue the filling buffer for get() and try to move filling to a free
+  // buffer. Caller holds mNextSlot_ and has set slotState_ to kSealed.
+  bool sealLocked(int bsize) {
+    assert(bsize > 0 && bsize <= batchsize_);
+    buffers_[fillIdx_].busy = true;
+    ready_.emplace_back(fillIdx_, bsize);
+    return advanceLocked();
+  }
 
-  TensorDict filledBuffer_;
-  std::shared_ptr<FutureReply> filledReply_;
+  bool advanceLocked() {
+    const int n = (int)buffers_.size();
+    for (int k = 1; k < n; ++k) {
+      const int idx = (fillIdx_ + k) % n;
+      if (!buffers_[idx].busy) {
+        fillIdx_ = idx;
+        buffers_[idx].reply =
+            std::make_shared<FutureReply>(batchdim_, schema_);
+        // reopen for writers, release publishes fillIdx_ and the new reply.
+        slotState_.store(0, std::memory_order_release);
+        return true;
+      }
+    }
+    return false;
+  }
 
-  // std::map<std::string, float> timer_;
-  // int counter_ = 0;
+  const int batchsize_;
+  const int batchdim_;
+  const int maxWaitUs_;
+  const bool pinMemory_;
+  const int numaNode_;
+  const std::shared_ptr<ReplySchema> schema_;
+
+  std::atomic<uint64_t> slotState_;
+  std::atomic<bool> initialized_{false};
+  // writers parked because every buffer of the ring is busy
+  WaitPolicy slotFree_;
+
+  std::vector<BatchBuffer> buffers_;
+  int fillIdx_;
+  // (buffer index, batchsize) of sealed batches, in sealing order.
+  std::deque<std::pair<int, int>> ready_;
+  std::deque<int> inFlight_;
 };
 
 }  // namespace rela
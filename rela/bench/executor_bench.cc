@@ -0,0 +1,117 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+//
+// Continuation throughput of FutureExecutor vs. the previous
+// deque<std::function> executor, on a rollout-like workload: every env
+// step adds a continuation capturing this, a reply future and an index,
+// which steps and adds the next one.
+//
+// usage: executor_bench [numRollouts] [numSteps]
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "rela/future_executor.h"
+
+using namespace rela;
+
+namespace {
+
+// previous FutureExecutor: copies the front out, then pops it
+class DequeExecutor {
+ public:
+  void addFuture(std::function<void()> f) {
+    futures_.push_back(f);
+  }
+
+  void execute() {
+    while (!futures_.empty()) {
+      auto f = futures_.front();
+      f();
+      futures_.pop_front();
+    }
+  }
+
+ private:
+  std::deque<std::function<void()>> futures_;
+};
+
+template <class Executor>
+class Rollout {
+ public:
+  Rollout(Executor& executor, int numSteps)
+      : executor_(executor)
+      , numSteps_(numSteps) {
+  }
+
+  void run() {
+    if (step_ == numSteps_) {
+      return;
+    }
+    // stands in for the TensorDictFuture of a batcher reply
+    auto shared = std::make_shared<int>(step_);
+    std::function<int()> future = [shared]() { return *shared; };
+    int idx = step_;
+    executor_.addFuture([this, future, idx]() {
+      sum_ += future() + idx;
+      ++step_;
+      run();
+    });
+  }
+
+  long sum() const {
+    return sum_;
+  }
+
+ private:
+  Executor& executor_;
+  const int numSteps_;
+  int step_ = 0;
+  long sum_ = 0;
+};
+
+template <class Executor>
+double stepsPerSec(int numRollouts, int numSteps) {
+  Executor executor;
+  std::vector<std::unique_ptr<Rollout<Executor>>> rollouts;
+  for (int i = 0; i < numRollouts; ++i) {
+    rollouts.push_back(
+        std::make_unique<Rollout<Executor>>(executor, numSteps));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (auto& r : rollouts) {
+    r->run();
+  }
+  executor.execute();
+  auto stop = std::chrono::steady_clock::now();
+
+  long check = 0;
+  for (auto& r : rollouts) {
+    check += r->sum();
+  }
+  if (check != (long)numRollouts * numSteps * (numSteps - 1)) {
+    std::cerr << "wrong result" << std::endl;
+  }
+  double sec = std::chrono::duration<double>(stop - start).count();
+  return (double)numRollouts * numSteps / sec;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int numRollouts = argc > 1 ? std::stoi(argv[1]) : 64;
+  const int numSteps = argc > 2 ? std::stoi(argv[2]) : 100000;
+
+  const double before = stepsPerSec<DequeExecutor>(numRollouts, numSteps);
+  const double after = stepsPerSec<FutureExecutor>(numRollouts, numSteps);
+
+  std::cout << numRollouts << " rollouts, " << numSteps << " steps each"
+            << std::endl;
+  std::cout << "  before: " << before / 1e6 << " M steps/s" << std::endl;
+  std::cout << "  after : " << after / 1e6 << " M steps/s" << std::endl;
+  return 0;
+}
@@ -0,0 +1,94 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+//
+// Cost of Transition::makeBatch on cpu: per-key vector append + join vs.
+// one preallocated output per key filled in parallel. Shapes follow the
+// bridge a2c transition. Both paths are checked to build the same batch
+// before timing.
+//
+// usage: make_batch_bench [batchsize] [iterations]
+
+#include <chrono>
+#include <iostream>
+
+#include "rela/types.h"
+#include "rela/utils.h"
+
+using namespace rela;
+
+namespace {
+
+Transition makeTransition() {
+  Transition t;
+  t.d["s"] = torch::rand({480});
+  t.d["legal_move"] = torch::ones({39});
+  t.d["pi"] = torch::rand({39});
+  t.d["a"] = torch::zeros({1}, torch::kInt64);
+  t.d["v"] = torch::rand({1});
+  t.d["R"] = torch::rand({1});
+  t.d["reward"] = torch::rand({1});
+  t.d["terminal"] = torch::zeros({1});
+  return t;
+}
+
+template <typename Func>
+double timeUs(int iterations, Func&& func) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    func();
+  }
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(stop - start).count() /
+         iterations;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int batchsize = argc > 1 ? std::stoi(argv[1]) : 128;
+  const int iterations = argc > 2 ? std::stoi(argv[2]) : 2000;
+
+  std::vector<Transition> transitions;
+  for (int i = 0; i < batchsize; ++i) {
+    transitions.push_back(makeTransition());
+  }
+
+  {
+    TensorVecDict vec;
+    for (const auto& t : transitions) {
+      utils::tensorVecDictAppend(vec, t.d);
+    }
+    const auto oldBatch = utils::tensorDictJoin(vec, 0);
+    const auto newBatch = Transition::makeBatch(transitions, 0, "cpu").d;
+    bool same = oldBatch.size() == newBatch.size();
+    for (const auto& kv : oldBatch) {
+      auto it = newBatch.find(kv.first);
+      same = same && it != newBatch.end() &&
+             torch::equal(kv.second, it->second);
+    }
+    if (!same) {
+      std::cerr << "batch mismatch" << std::endl;
+      return 1;
+    }
+  }
+
+  // previous path: collect per key, then torch::stack per key.
+  const double before = timeUs(iterations, [&]() {
+    TensorVecDict vec;
+    for (const auto& t : transitions) {
+      utils::tensorVecDictAppend(vec, t.d);
+    }
+    auto batch = utils::tensorDictJoin(vec, 0);
+    return batch.size();
+  });
+
+  const double after = timeUs(iterations, [&]() {
+    auto batch = Transition::makeBatch(transitions, 0, "cpu");
+    return batch.d.size();
+  });
+
+  std::cout << "batchsize " << batchsize << ", " << iterations
+            << " iterations" << std::endl;
+  std::cout << "  before: " << before << " us/batch" << std::endl;
+  std::cout << "  after : " << after << " us/batch" << std::endl;
+  return 0;
+}
@@ -0,0 +1,113 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+//
+// Per batch marshalling overhead of BatchProcessor on cpu, i.e. everything
+// around the TorchScript call: batch TensorDict -> jit input, jit output ->
+// reply TensorDict. Shapes follow the bridge "act" call. Both paths are
+// checked to build the same jit input and reply before timing.
+//
+// usage: marshal_bench [batchsize] [iterations]
+
+#include <chrono>
+#include <iostream>
+
+#include "rela/utils.h"
+
+using namespace rela;
+
+namespace {
+
+TensorDict makeBatch(int batchsize) {
+  TensorDict batch;
+  batch["s"] = torch::rand({batchsize, 480});
+  batch["legal_move"] = torch::ones({batchsize, 39});
+  batch["h0"] = torch::rand({batchsize, 1, 200});
+  return batch;
+}
+
+torch::IValue makeOutput(int batchsize) {
+  TorchTensorDict output;
+  output.insert("a", torch::zeros({batchsize}, torch::kInt64));
+  output.insert("pi", torch::rand({batchsize, 39}));
+  output.insert("v", torch::rand({batchsize, 1}));
+  output.insert("h0", torch::rand({batchsize, 1, 200}));
+  return output;
+}
+
+bool sameDict(const TensorDict& lhs, const TensorDict& rhs) {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  for (const auto& kv : lhs) {
+    auto it = rhs.find(kv.first);
+    if (it == rhs.end() || !torch::equal(kv.second, it->second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Func>
+double timeUs(int iterations, Func&& func) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    func();
+  }
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(stop - start).count() /
+         iterations;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int batchsize = argc > 1 ? std::stoi(argv[1]) : 128;
+  const int iterations = argc > 2 ? std::stoi(argv[2]) : 20000;
+  const torch::Device device(torch::kCPU);
+
+  const TensorDict batch = makeBatch(batchsize);
+  const torch::IValue output = makeOutput(batchsize);
+
+  {
+    TorchTensorDict inputDict;
+    TensorDict staging;
+    utils::tensorDictToTorchDict(batch, device, inputDict);
+    const auto oldInput = utils::tensorDictToTorchDict(batch, device);
+    bool same = oldInput.size() == inputDict.size();
+    for (const auto& kv : oldInput) {
+      same = same && inputDict.contains(kv.key()) &&
+             torch::equal(kv.value(), inputDict.at(kv.key()));
+    }
+    same = same &&
+           sameDict(utils::iValueToTensorDict(output, torch::kCPU, true),
+                    utils::iValueToTensorDict(output, staging));
+    if (!same) {
+      std::cerr << "marshalled batch mismatch" << std::endl;
+      return 1;
+    }
+  }
+
+  // previous path: fresh dict and .to() per key in, rehash + .to() out.
+  const double before = timeUs(iterations, [&]() {
+    TorchJitInput jitInput;
+    jitInput.push_back(utils::tensorDictToTorchDict(batch, device));
+    auto reply = utils::iValueToTensorDict(output, torch::kCPU, true);
+    return reply.size();
+  });
+
+  // BatchProcessor::batchForward: persistent dict, staging reused.
+  TorchTensorDict inputDict;
+  TorchJitInput jitInput(1);
+  TensorDict staging;
+  const double after = timeUs(iterations, [&]() {
+    utils::tensorDictToTorchDict(batch, device, inputDict);
+    jitInput[0] = inputDict;
+    auto reply = utils::iValueToTensorDict(output, staging);
+    return reply.size();
+  });
+
+  std::cout << "batchsize " << batchsize << ", " << iterations
+            << " iterations" << std::endl;
+  std::cout << "  before: " << before << " us/batch" << std::endl;
+  std::cout << "  after : " << after << " us/batch" << std::endl;
+  return 0;
+}
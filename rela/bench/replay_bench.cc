@@ -0,0 +1,108 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+//
+// Index selection cost of prioritized replay: the linear prefix scan the
+// queues used to do per sample() against the SumTree lookup, plus the cost
+// of a priority update for the same batch. Element copies and makeBatch are
+// the same for both and left out.
+//
+// usage: replay_bench [batchsize] [rounds]
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "rela/sum_tree.h"
+
+using namespace rela;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double usSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start)
+      .count();
+}
+
+// the former ConcurrentQueue sampling loop, one pass over the buffer
+void linearSample(const std::vector<float>& weights,
+                  double sum,
+                  int batchsize,
+                  std::mt19937& rng,
+                  std::vector<int>* ids) {
+  float segment = sum / batchsize;
+  std::uniform_real_distribution<float> dist(0.0, segment);
+  double accSum = 0;
+  int nextIdx = 0;
+  for (int i = 0; i < batchsize; ++i) {
+    float rand = std::min((float)sum - (float)0.1, dist(rng) + i * segment);
+    while (accSum == 0 || accSum < rand) {
+      accSum += weights[nextIdx++];
+    }
+    (*ids)[i] = nextIdx - 1;
+  }
+}
+
+void treeSample(const SumTree& tree,
+                int batchsize,
+                std::mt19937& rng,
+                std::vector<int>* ids) {
+  double total = tree.total();
+  double segment = total / batchsize;
+  std::uniform_real_distribution<double> dist(0.0, segment);
+  for (int i = 0; i < batchsize; ++i) {
+    (*ids)[i] = tree.find(std::min(dist(rng) + i * segment, total));
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int batchsize = argc > 1 ? std::stoi(argv[1]) : 512;
+  const int numRound = argc > 2 ? std::stoi(argv[2]) : 20;
+
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> priority(0.01, 1.0);
+  std::vector<int> ids(batchsize);
+
+  for (int capacity : {100000, 1000000, 4000000}) {
+    std::vector<float> weights(capacity);
+    SumTree tree(capacity);
+    double sum = 0;
+    for (int i = 0; i < capacity; ++i) {
+      weights[i] = priority(rng);
+      tree.set(i, weights[i]);
+      sum += weights[i];
+    }
+
+    auto start = Clock::now();
+    for (int r = 0; r < numRound; ++r) {
+      linearSample(weights, sum, batchsize, rng, &ids);
+    }
+    double linearUs = usSince(start) / numRound;
+
+    start = Clock::now();
+    for (int r = 0; r < numRound; ++r) {
+      treeSample(tree, batchsize, rng, &ids);
+    }
+    double treeUs = usSince(start) / numRound;
+
+    start = Clock::now();
+    for (int r = 0; r < numRound; ++r) {
+      for (int id : ids) {
+        tree.set(id, priority(rng));
+      }
+    }
+    double updateUs = usSince(start) / numRound;
+
+    std::cout << "capacity " << capacity << ", batchsize " << batchsize
+              << ", us per batch:" << std::endl;
+    std::cout << "  linear sample: " << linearUs << std::endl;
+    std::cout << "  tree sample  : " << treeUs << std::endl;
+    std::cout << "  tree update  : " << updateUs << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,80 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+//
+// Compares the wait policies of rela/wait_policy.h on the FutureReply
+// pattern: N producers each post a request and wait for the batch reply, a
+// single consumer answers once all N have arrived.
+//
+// usage: wait_bench [rounds]
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rela/wait_policy.h"
+
+using namespace rela;
+
+namespace {
+
+template <typename Policy>
+struct Reply {
+  std::atomic<int> arrived{0};
+  std::atomic<bool> ready{false};
+  Policy waiter;
+};
+
+template <typename Policy>
+double roundsPerSec(int numProducer, int numRound) {
+  std::vector<std::unique_ptr<Reply<Policy>>> replies;
+  for (int i = 0; i < numRound; ++i) {
+    replies.push_back(std::make_unique<Reply<Policy>>());
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (int p = 0; p < numProducer; ++p) {
+    producers.emplace_back([&]() {
+      for (int r = 0; r < numRound; ++r) {
+        auto& reply = *replies[r];
+        reply.arrived.fetch_add(1);
+        reply.waiter.wait([&reply] { return reply.ready.load(); });
+      }
+    });
+  }
+
+  for (int r = 0; r < numRound; ++r) {
+    auto& reply = *replies[r];
+    while (reply.arrived.load() < numProducer) {
+      std::this_thread::yield();
+    }
+    reply.ready.store(true);
+    reply.waiter.notifyAll();
+  }
+
+  for (auto& t : producers) {
+    t.join();
+  }
+  auto stop = std::chrono::steady_clock::now();
+  return numRound / std::chrono::duration<double>(stop - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int numRound = argc > 1 ? std::stoi(argv[1]) : 2000;
+
+  for (int numProducer : {16, 64, 256}) {
+    std::cout << numProducer << " producers, rounds/s:" << std::endl;
+    std::cout << "  spin+futex: "
+              << roundsPerSec<SpinFutexWait>(numProducer, numRound)
+              << std::endl;
+    std::cout << "  fiber     : "
+              << roundsPerSec<FiberWait>(numProducer, numRound) << std::endl;
+    std::cout << "  condvar   : "
+              << roundsPerSec<CondVarWait>(numProducer, numRound) << std::endl;
+  }
+  return 0;
+}
@@ -3,19 +3,44 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <iostream>
 #include <memory>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include "rela/fiber_pool.h"
+#include "rela/logging.h"
 #include "rela/thread_loop.h"
+#include "rela/topology.h"
 
 namespace rela {
 
+// Runs pushed loops either on one thread each (numThreads == 0), or as
+// fibers on a FiberPool of numThreads threads. The latter needs a build with
+// RELA_FIBER_WAIT, otherwise a loop waiting on a reply blocks its thread
+// and every loop queued behind it.
+//
+// pinThreads pins each pool thread to a cpu, or, with a thread per loop,
+// splits the loops into one contiguous block per NUMA node and pins each
+// block to its node. start() then prints the resulting placement.
 class Context {
  public:
   Context()
-      : started_(false)
+      : Context(0, false) {
+  }
+
+  explicit Context(int numThreads, bool pinThreads = true)
+      : numThreads_(numThreads)
+      , pinThreads_(pinThreads)
+      , started_(false)
       , numTerminatedThread_(0) {
+    RELA_CHECK_GE(numThreads_, 0);
+#ifndef RELA_FIBER_WAIT
+    RELA_CHECK(numThreads_ == 0,
+               "running loops on a thread pool needs RELA_FIBER_WAIT");
+#endif
   }
 
   Context(const Context&) = delete;
@@ -25,6 +50,7 @@ class Context {
     for (auto& v : loops_) {
       v->terminate();
     }
+    pool_.reset();
     for (auto& v : threads_) {
       v.join();
     }
@@ -37,11 +63,52 @@ class Context {
   }
 
   void start() {
-    for (int i = 0; i < (int)loops_.size(); ++i) {
-      threads_.emplace_back([this, i]() {
-        loops_[i]->mainLoop();
-        ++numTerminatedThread_;
-      });
+    assert(!started_);
+    started_ = true;
+    if (numThreads_ > 0) {
+      std::vector<std::function<void()>> tasks;
+      for (int i = 0; i < (int)loops_.size(); ++i) {
+        tasks.push_back([this, i]() {
+          loops_[i]->mainLoop();
+          loops_[i]->markDone();
+          ++numTerminatedThread_;
+        });
+      }
+      pool_ = std::make_unique<FiberPool>(
+          numThreads_, std::move(tasks), pinThreads_);
+    } else {
+      const int numLoops = (int)loops_.size();
+      const int numNodes = Topology::get().numNodes();
+      int blockBegin = 0;
+      bool blockPinned = true;
+      for (int i = 0; i < numLoops; ++i) {
+        threads_.emplace_back([this, i]() {
+          loops_[i]->mainLoop();
+          loops_[i]->markDone();
+          ++numTerminatedThread_;
+        });
+        if (!pinThreads_) {
+          continue;
+        }
+        const int node = i * numNodes / numLoops;
+        if (!pinThreadToNode(threads_.back(), node)) {
+          std::cerr << "failed to pin env loop " << i << " to node " << node
+                    << std::endl;
+          blockPinned = false;
+        }
+        if (i + 1 == numLoops || (i + 1) * numNodes / numLoops != node) {
+          if (blockPinned) {
+            recordPlacement("env loops " + std::to_string(blockBegin) + "-" +
+                                std::to_string(i),
+                            "node " + std::to_string(node));
+          }
+          blockBegin = i + 1;
+          blockPinned = true;
+        }
+      }
+    }
+    if (pinThreads_) {
+      std::cout << topologyReport();
     }
   }
 
@@ -51,6 +118,21 @@ class Context {
     }
   }
 
+  // Pauses every loop and waits until each one is parked with no futures in
+  // flight, or until timeoutMs has passed. Returns whether all of them
+  // parked; either way they stay paused until resume(). Pair with
+  // Models::setDraining so that batches held for maxWaitUs go out at once.
+  bool drain(int timeoutMs) {
+    pause();
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeoutMs);
+    bool drained = true;
+    for (auto& v : loops_) {
+      drained = v->waitUntilParked(deadline) && drained;
+    }
+    return drained;
+  }
+
   void resume() {
     for (auto& v : loops_) {
       v->resume();
@@ -69,9 +151,12 @@ class Context {
   }
 
  private:
+  const int numThreads_;
+  const bool pinThreads_;
   bool started_;
   std::atomic<int> numTerminatedThread_;
   std::vector<std::shared_ptr<ThreadLoop>> loops_;
   std::vector<std::thread> threads_;
+  std::unique_ptr<FiberPool> pool_;
 };
 }  // namespace rela
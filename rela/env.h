@@ -79,6 +79,14 @@ class Env {
     return actions;
   }
 
+  // Legal actions of the player to move as a bitmask, bit i for action i.
+  // Returns false if the env can't tell (e.g. more than 64 actions), then
+  // callers go through legalActions() or the "legal_move" feature instead.
+  virtual bool legalActionBits(uint64_t* mask) const {
+    (void)mask;
+    return false;
+  }
+
   // Return partners playerIndices.
   virtual std::vector<int> partnerIndices(int playerIdx) const {
     (void)playerIdx;
@@ -91,6 +99,21 @@ class Env {
     return {};
   }
 
+  // Writes feature() into row `row` of batch, whose tensors have a leading
+  // batch dim (a VectorEnv, or a batcher slot, see Batcher::sendInPlace).
+  // The env overwrites its part of the row. A field may be wider than the
+  // env's, e.g. "s" with SAD appended: the env writes the leading part and
+  // the caller the rest. Override to compute the feature in place.
+  virtual void writeFeature(const TensorDict& batch, int row) const {
+    for (const auto& kv : feature()) {
+      torch::Tensor dst = batch.at(kv.first)[row];
+      if (dst.dim() > 0 && dst.size(0) > kv.second.size(0)) {
+        dst = dst.narrow(0, 0, kv.second.size(0));
+      }
+      dst.copy_(kv.second);
+    }
+  }
+
   virtual int featureDim() const { 
     return spec().featureSize;
   }
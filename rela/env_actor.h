@@ -62,20 +62,48 @@ class EnvActor : public EnvActorBase {
   void preAct() override {
     auto playerIdx = env_->playerIdx();
 
-    // Get feature.
-    auto obs = env_->feature();
+    uint64_t legalMask;
+    if (env_->legalActionBits(&legalMask)) {
+      actors_[playerIdx]->setLegalActions(legalMask);
+    }
+
+    // Compute the feature straight into the batcher slot when the actor
+    // allows it; the replay keeps a copy of the row. The fields come from a
+    // regular feature() first.
+    rela::TensorDict obs;
+    actFuture_ = nullptr;
+    if (!featureFields_.empty()) {
+      actFuture_ = actors_[playerIdx]->actInPlace(
+          featureFields_,
+          [this, &obs](const rela::TensorDict& batch, int row) {
+            env_->writeFeature(batch, row);
+            if (sadDimension_ > 0) {
+              writeGreedyOneHot(batch.at("s")[row].narrow(
+                  0, env_->featureDim(), sadDimension_));
+            }
+            for (const auto& kv : batch) {
+              obs.emplace(kv.first, kv.second[row].clone());
+            }
+          });
+    }
+    if (actFuture_ != nullptr) {
+      replays_[playerIdx].push_back(std::move(obs));
+      return;
+    }
+
+    // Get feature. Its keys are what the next preAct tries in place; they
+    // are refreshed here so that a changed key set only costs one step on
+    // this path.
+    obs = env_->feature();
+    featureFields_.clear();
+    for (const auto& kv : obs) {
+      featureFields_.push_back(kv.first);
+    }
 
     if (sadDimension_ > 0) {
-      const auto& acts = greedyActions_[subgameIdx_];
-      // The history is at most maxRound_ - 1 long.
-      assert((int)acts.size() <= maxRound_ - 1);
       // additional dimension.
-      auto greedyOneHot = torch::zeros({sadDimension_}, torch::kFloat32);
-      auto accessor = greedyOneHot.accessor<float, 1>();
-      for (int i = 0; i < (int)acts.size(); ++i) {
-        assert(acts[i] < maxPlayerAction_);
-        accessor[i * maxPlayerAction_ + acts[i]] = 1.0f;
-      }
+      auto greedyOneHot = torch::empty({sadDimension_}, torch::kFloat32);
+      writeGreedyOneHot(greedyOneHot);
       // Update the input state.
       obs["s"] = torch::cat({obs["s"], greedyOneHot});
     }
@@ -220,6 +248,19 @@ class EnvActor : public EnvActorBase {
   }
 
  private:
+  // SAD one-hot of the greedy actions so far into dst, [sadDimension_]
+  void writeGreedyOneHot(torch::Tensor dst) const {
+    const auto& acts = greedyActions_[subgameIdx_];
+    // The history is at most maxRound_ - 1 long.
+    assert((int)acts.size() <= maxRound_ - 1);
+    dst.zero_();
+    auto accessor = dst.accessor<float, 1>();
+    for (int i = 0; i < (int)acts.size(); ++i) {
+      assert(acts[i] < maxPlayerAction_);
+      accessor[i * maxPlayerAction_ + acts[i]] = 1.0f;
+    }
+  }
+
   // One environment.
   std::shared_ptr<rela::Env> env_;
   int subgameIdx_ = 0;
@@ -228,6 +269,8 @@ class EnvActor : public EnvActorBase {
   std::vector<std::deque<rela::TensorDict>> replays_;
 
   rela::TensorDictFuture actFuture_ = nullptr;
+  // fields of env_->feature(), for Actor2::actInPlace
+  std::vector<std::string> featureFields_;
 
   std::vector<std::vector<float>> probs_;
   std::vector<std::vector<int>> greedyActions_;
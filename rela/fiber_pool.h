@@ -0,0 +1,115 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <cassert>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/fiber/algo/work_stealing.hpp>
+#include <boost/fiber/condition_variable.hpp>
+#include <boost/fiber/fiber.hpp>
+#include <boost/fiber/fixedsize_stack.hpp>
+#include <boost/fiber/mutex.hpp>
+#include <boost/fiber/operations.hpp>
+
+#include "rela/topology.h"
+
+namespace rela {
+
+// Runs tasks as fibers on a fixed number of threads with boost's
+// work-stealing scheduler, so a task that blocks on a fiber-aware wait
+// (FiberWait) gives its thread to other tasks instead of holding it.
+// Tasks may migrate between threads, so they must not rely on
+// thread_local state staying put across waits.
+class FiberPool {
+ public:
+  // fiber stacks are allocated lazily by the OS, so this is mostly address
+  // space; env loops call into torch and need more than boost's default
+  static constexpr size_t kStackSize = 1 << 20;
+
+  FiberPool(int numThreads,
+            std::vector<std::function<void()>> tasks,
+            bool pinThreads = true)
+      : numThreads_(numThreads)
+      , pinThreads_(pinThreads)
+      , tasks_(std::move(tasks)) {
+    assert(numThreads_ > 0);
+    const auto& topology = Topology::get();
+    for (int i = 0; i < numThreads_; ++i) {
+      threads_.emplace_back([this, i]() { workerLoop(i); });
+      if (!pinThreads_) {
+        continue;
+      }
+      const int cpu = cpuOf(i);
+      const std::string what = "pool thread " + std::to_string(i);
+      if (pinThreadToCpus(threads_.back(), {cpu})) {
+        recordPlacement(what,
+                        "cpu " + std::to_string(cpu) + ", node " +
+                            std::to_string(topology.nodeOfCpu(cpu)));
+      } else {
+        std::cerr << "failed to pin " << what << " to cpu " << cpu
+                  << std::endl;
+      }
+    }
+  }
+
+  FiberPool(const FiberPool&) = delete;
+  FiberPool& operator=(const FiberPool&) = delete;
+
+  // returns once every task has returned
+  ~FiberPool() {
+    for (auto& t : threads_) {
+      t.join();
+    }
+  }
+
+ private:
+  // fills a node before moving on to the next one
+  static int cpuOf(int idx) {
+    const auto& cpus = Topology::get().cpus();
+    return cpus[idx % cpus.size()];
+  }
+
+  void workerLoop(int idx) {
+    // every pool thread has to join the scheduler before any can proceed.
+    // suspend lets idle threads sleep instead of spinning on steals
+    boost::fibers::use_scheduling_algorithm<
+        boost::fibers::algo::work_stealing>(numThreads_, true);
+
+    // seed each thread with its share, stealing balances the rest
+    for (int i = idx; i < (int)tasks_.size(); i += numThreads_) {
+      boost::fibers::fiber(std::allocator_arg,
+                           boost::fibers::fixedsize_stack(kStackSize),
+                           [this, i]() {
+                             tasks_[i]();
+                             std::lock_guard<boost::fibers::mutex> lk(m_);
+                             if (++numDone_ == (int)tasks_.size()) {
+                               cvDone_.notify_all();
+                             }
+                           })
+          .detach();
+    }
+
+    // the scheduler runs fibers only while the thread's main fiber waits
+    std::unique_lock<boost::fibers::mutex> lk(m_);
+    cvDone_.wait(lk, [this] { return numDone_ == (int)tasks_.size(); });
+  }
+
+  const int numThreads_;
+  const bool pinThreads_;
+  const std::vector<std::function<void()>> tasks_;
+
+  boost::fibers::mutex m_;
+  boost::fibers::condition_variable cvDone_;
+  int numDone_ = 0;
+
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace rela
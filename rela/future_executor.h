@@ -0,0 +1,59 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "rela/inline_function.h"
+
+namespace rela {
+
+// Continuations of an env loop, run in the order they were added. Futures
+// are moved in and run in place: no copies, and the two queues keep their
+// capacity, so a steady loop does not allocate unless a continuation is
+// too big to be stored inline.
+class FutureExecutor {
+ public:
+  template <class F>
+  void addFuture(F&& f) {
+    pending_.emplace_back(std::forward<F>(f));
+  }
+
+  // runs until nothing is pending, including futures added while running
+  void execute() {
+    int count = 0;
+    while (!pending_.empty()) {
+      // futures added by this round land in pending_ and run in the next
+      running_.swap(pending_);
+      try {
+        for (auto& f : running_) {
+          f();
+          count++;
+          // warn once rather than on every future past the limit
+          if (count == 2000000) {
+            std::cout << "FutureExecutor::execute(): counter exceeded. "
+                      << "Something wrong!" << std::endl;
+          }
+        }
+      } catch (...) {
+        // otherwise the next execute() would swap these back in and run
+        // the ones that already ran again
+        running_.clear();
+        throw;
+      }
+      running_.clear();
+
+      // [TODO]: This is needed if we use static batching
+      // If there is new request then:
+      // for (auto &v : models_) { v->processRequest(); }
+    }
+  }
+
+ private:
+  std::vector<InlineFunction> pending_;
+  std::vector<InlineFunction> running_;
+};
+
+}  // namespace rela
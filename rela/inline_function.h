@@ -0,0 +1,121 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace rela {
+
+// Move-only void() callable. Callables up to kInlineSize bytes, e.g. a
+// lambda capturing this, a future and an index, are stored in place;
+// bigger ones fall back to the heap. Unlike std::function it never copies
+// the callable.
+class InlineFunction {
+ public:
+  static constexpr size_t kInlineSize = 64;
+
+  InlineFunction() = default;
+
+  template <class F,
+            class D = std::decay_t<F>,
+            class = std::enable_if_t<!std::is_same<D, InlineFunction>::value>>
+  InlineFunction(F&& f) {
+    construct<D>(std::forward<F>(f),
+                 std::integral_constant<bool, fitsInline<D>()>());
+  }
+
+  InlineFunction(InlineFunction&& other) noexcept {
+    moveFrom(other);
+  }
+
+  InlineFunction& operator=(InlineFunction&& other) noexcept {
+    if (this != &other) {
+      reset();
+      moveFrom(other);
+    }
+    return *this;
+  }
+
+  InlineFunction(const InlineFunction&) = delete;
+  InlineFunction& operator=(const InlineFunction&) = delete;
+
+  ~InlineFunction() {
+    reset();
+  }
+
+  void operator()() {
+    ops_->call(&storage_);
+  }
+
+  explicit operator bool() const {
+    return ops_ != nullptr;
+  }
+
+ private:
+  struct Ops {
+    void (*call)(void*);
+    // move constructs into dst and destroys src
+    void (*relocate)(void* dst, void* src);
+    void (*destroy)(void*);
+  };
+
+  using Storage =
+      std::aligned_storage_t<kInlineSize, alignof(std::max_align_t)>;
+
+  template <class D>
+  static constexpr bool fitsInline() {
+    return sizeof(D) <= kInlineSize &&
+           alignof(D) <= alignof(std::max_align_t) &&
+           std::is_nothrow_move_constructible<D>::value;
+  }
+
+  template <class D, class F>
+  void construct(F&& f, std::true_type /* inline */) {
+    static const Ops ops = {
+        [](void* p) { (*static_cast<D*>(p))(); },
+        [](void* dst, void* src) {
+          new (dst) D(std::move(*static_cast<D*>(src)));
+          static_cast<D*>(src)->~D();
+        },
+        [](void* p) { static_cast<D*>(p)->~D(); },
+    };
+    new (&storage_) D(std::forward<F>(f));
+    ops_ = &ops;
+  }
+
+  template <class D, class F>
+  void construct(F&& f, std::false_type /* inline */) {
+    static const Ops ops = {
+        [](void* p) { (**static_cast<D**>(p))(); },
+        [](void* dst, void* src) {
+          *static_cast<D**>(dst) = *static_cast<D**>(src);
+        },
+        [](void* p) { delete *static_cast<D**>(p); },
+    };
+    *reinterpret_cast<D**>(&storage_) = new D(std::forward<F>(f));
+    ops_ = &ops;
+  }
+
+  void moveFrom(InlineFunction& other) {
+    if (other.ops_ != nullptr) {
+      other.ops_->relocate(&storage_, &other.storage_);
+      ops_ = other.ops_;
+      other.ops_ = nullptr;
+    }
+  }
+
+  void reset() {
+    if (ops_ != nullptr) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  Storage storage_;
+  const Ops* ops_ = nullptr;
+};
+
+}  // namespace rela
@@ -0,0 +1,168 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#include "rela/metrics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rela/logging.h"
+
+namespace rela {
+namespace metrics {
+
+namespace {
+
+struct Entry {
+  std::string name;
+  Kind kind;
+  int slot;
+};
+
+class Registry {
+ public:
+  static Registry& get() {
+    // never destroyed: threads may record while the process exits
+    static Registry* registry = new Registry();
+    return *registry;
+  }
+
+  int intern(const std::string& name, Kind kind) {
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = byName_.find(name);
+    if (it != byName_.end()) {
+      const auto& entry = entries_[it->second];
+      RELA_CHECK(entry.kind == kind, "metric ", name, " has another kind");
+      return entry.slot;
+    }
+    const int size = kind == Kind::COUNTER ? 1 : 2 + kNumBuckets;
+    RELA_CHECK(nextSlot_ + size <= kMaxSlots, "too many metrics");
+    byName_.emplace(name, (int)entries_.size());
+    entries_.push_back({name, kind, nextSlot_});
+    nextSlot_ += size;
+    return entries_.back().slot;
+  }
+
+  Shard* newShard() {
+    std::lock_guard<std::mutex> lk(m_);
+    // value initialized, so every slot starts at 0
+    shards_.push_back(std::make_unique<Shard>());
+    return shards_.back().get();
+  }
+
+  // folds the shard of an exiting thread into retired_ and frees it
+  void retireShard(Shard* shard) {
+    std::lock_guard<std::mutex> lk(m_);
+    for (int i = 0; i < nextSlot_; ++i) {
+      retired_[i] += shard->slots[i].load(std::memory_order_relaxed);
+    }
+    auto it = std::find_if(
+        shards_.begin(), shards_.end(),
+        [shard](const std::unique_ptr<Shard>& s) { return s.get() == shard; });
+    assert(it != shards_.end());
+    shards_.erase(it);
+  }
+
+  std::unordered_map<std::string, double> snapshot() {
+    std::lock_guard<std::mutex> lk(m_);
+    auto sum = [this](int slot) {
+      uint64_t total = retired_[slot];
+      for (const auto& shard : shards_) {
+        total += shard->slots[slot].load(std::memory_order_relaxed);
+      }
+      return total;
+    };
+
+    std::unordered_map<std::string, double> result;
+    for (const auto& entry : entries_) {
+      if (entry.kind == Kind::COUNTER) {
+        result[entry.name] = sum(entry.slot);
+        continue;
+      }
+      const uint64_t count = sum(entry.slot);
+      const uint64_t total = sum(entry.slot + 1);
+      uint64_t buckets[kNumBuckets];
+      for (int b = 0; b < kNumBuckets; ++b) {
+        buckets[b] = sum(entry.slot + 2 + b);
+      }
+      result[entry.name + ".count"] = count;
+      result[entry.name + ".sum"] = total;
+      result[entry.name + ".mean"] = count > 0 ? (double)total / count : 0;
+      for (int p : {50, 90, 99}) {
+        result[entry.name + ".p" + std::to_string(p)] =
+            percentile(buckets, count, p);
+      }
+    }
+    result["time_s"] = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start_)
+                           .count();
+    return result;
+  }
+
+ private:
+  Registry()
+      : start_(std::chrono::steady_clock::now())
+      , retired_(kMaxSlots, 0) {
+  }
+
+  // geometric middle of the bucket holding the p-th percentile
+  static double percentile(const uint64_t* buckets, uint64_t count, int p) {
+    if (count == 0) {
+      return 0;
+    }
+    const uint64_t rank = (count * p + 99) / 100;
+    uint64_t seen = 0;
+    for (int b = 0; b < kNumBuckets; ++b) {
+      seen += buckets[b];
+      if (seen >= rank) {
+        // buckets 0 and 1 hold exactly 0 and 1
+        return b <= 1 ? b : std::ldexp(std::sqrt(2.0), b - 1);
+      }
+    }
+    return 0;
+  }
+
+  const std::chrono::steady_clock::time_point start_;
+  std::mutex m_;
+  std::vector<Entry> entries_;
+  std::unordered_map<std::string, int> byName_;
+  int nextSlot_ = 0;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  // totals of the threads that have exited
+  std::vector<uint64_t> retired_;
+};
+
+// frees the thread's shard when the thread exits, so that short lived
+// threads don't keep their slots around
+struct ShardOwner {
+  ShardOwner()
+      : shard(Registry::get().newShard()) {
+  }
+
+  ~ShardOwner() {
+    Registry::get().retireShard(shard);
+  }
+
+  Shard* const shard;
+};
+
+}  // namespace
+
+Shard& localShard() {
+  thread_local ShardOwner owner;
+  return *owner.shard;
+}
+
+int intern(const std::string& name, Kind kind) {
+  return Registry::get().intern(name, kind);
+}
+
+std::unordered_map<std::string, double> snapshot() {
+  return Registry::get().snapshot();
+}
+
+}  // namespace metrics
+}  // namespace rela
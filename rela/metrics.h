@@ -0,0 +1,108 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace rela {
+namespace metrics {
+
+// Process wide counters and histograms, cheap enough to stay on.
+//
+// A metric is interned once, when its Counter / Histogram is constructed,
+// to a fixed range of slots. Every thread accumulates into its own array of
+// slots, so recording is a relaxed load and store on memory no other thread
+// writes; snapshot() sums the slots of all threads, past and present. A
+// thread's slots are folded into a shared total and freed when it exits.
+//
+// Histograms bucket values by power of two, which is plenty for latencies
+// and keeps recording to three slot updates. Bounded values such as fill
+// ratios are too coarse there; record them as a pair of counters instead.
+
+constexpr int kMaxSlots = 4096;
+// bucket b holds values in [2^(b-1), 2^b), bucket 0 holds 0
+constexpr int kNumBuckets = 65;
+
+struct Shard {
+  std::atomic<uint64_t> slots[kMaxSlots];
+};
+
+// the calling thread's shard, created on first use
+Shard& localShard();
+
+enum class Kind { COUNTER, HISTOGRAM };
+
+// first slot of name, registering it on first use
+int intern(const std::string& name, Kind kind);
+
+// single writer per shard, so no atomic read-modify-write is needed
+inline void bump(std::atomic<uint64_t>& slot, uint64_t n) {
+  slot.store(slot.load(std::memory_order_relaxed) + n,
+             std::memory_order_relaxed);
+}
+
+class Counter {
+ public:
+  explicit Counter(const std::string& name)
+      : slot_(intern(name, Kind::COUNTER)) {
+  }
+
+  void add(uint64_t n = 1) const {
+    bump(localShard().slots[slot_], n);
+  }
+
+ private:
+  const int slot_;
+};
+
+class Histogram {
+ public:
+  explicit Histogram(const std::string& name)
+      : slot_(intern(name, Kind::HISTOGRAM)) {
+  }
+
+  void record(uint64_t value) const {
+    const int bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    // slots: count, sum, then the buckets
+    Shard& shard = localShard();
+    bump(shard.slots[slot_], 1);
+    bump(shard.slots[slot_ + 1], value);
+    bump(shard.slots[slot_ + 2 + bucket], 1);
+  }
+
+ private:
+  const int slot_;
+};
+
+// records the microseconds it was alive into a Histogram
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(const Histogram& histogram)
+      : histogram_(histogram)
+      , start_(std::chrono::steady_clock::now()) {
+  }
+
+  ~ScopedTimer() {
+    histogram_.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - start_)
+                          .count());
+  }
+
+ private:
+  const Histogram& histogram_;
+  const std::chrono::steady_clock::time_point start_;
+};
+
+// Totals over all threads. A counter shows up as "name"; a histogram as
+// "name.count", "name.sum", "name.mean" and "name.p50" / ".p90" / ".p99",
+// the percentiles resolved to their power of two bucket. "time_s" is the
+// time since the first metric was registered, for turning counters into
+// rates.
+std::unordered_map<std::string, double> snapshot();
+
+}  // namespace metrics
+}  // namespace rela
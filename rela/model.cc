@@ -1,14 +1,147 @@
 #include "rela/model.h"
 
+#include <algorithm>
+#include <iostream>
+
+#include "rela/metrics.h"
+
 namespace rela {
 
-void BatchProcessor::batchForward() {
+namespace {
+
+bool anyCuda(const std::vector<torch::Device>& devices) {
+  for (const auto& d : devices) {
+    if (d.is_cuda()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+BatchProcessor::BatchProcessor(
+    std::vector<std::shared_ptr<ModelLocker>> modelLockers,
+    std::vector<torch::Device> devices, const std::string& funcName,
+    int batchsize, Dispatch dispatch, int maxWaitUs, int numBuffers,
+    Placement placement)
+    : modelLockers_(std::move(modelLockers)),
+      devices_(std::move(devices)),
+      funcName_(funcName),
+      dispatch_(dispatch) {
+  RELA_CHECK(!modelLockers_.empty());
+  RELA_CHECK_EQ(modelLockers_.size(), devices_.size());
+  const int numReplica = (int)modelLockers_.size();
+  // checked here: an unknown node would only fail inside the forward thread
+  RELA_CHECK_LT(placement.numaNode, Topology::get().numNodes(),
+                "numa node out of range");
+
+  int numLanes = 1;
+  if (placement.batcherPerNode) {
+    numLanes = std::min(Topology::get().numNodes(), numReplica);
+  }
+  // Lane holds a mutex, so the vector is sized once and never moved
+  lanes_ = std::vector<Lane>(numLanes);
+  for (int i = 0; i < numLanes; ++i) {
+    lanes_[i].numaNode = placement.batcherPerNode ? i : placement.numaNode;
+  }
+  for (int i = 0; i < numReplica; ++i) {
+    replicaLane_.push_back(i % numLanes);
+    lanes_[i % numLanes].replicas.push_back(i);
+  }
+
+  auto schema = std::make_shared<ReplySchema>();
+  for (int i = 0; i < numLanes; ++i) {
+    auto& lane = lanes_[i];
+    // every replica may hold a batch while another one is being filled.
+    lane.batcher = std::make_unique<Batcher>(
+        batchsize, 0, maxWaitUs,
+        std::max(numBuffers, (int)lane.replicas.size() + 1),
+        anyCuda(devices_), lane.numaNode, schema);
+    if (lane.numaNode >= 0) {
+      recordPlacement(funcName_ + " batcher " + std::to_string(i),
+                      "node " + std::to_string(lane.numaNode));
+    }
+  }
+
+  for (int i = 0; i < numReplica; ++i) {
+    forwardThreads_.emplace_back(&BatchProcessor::batchForward, this, i);
+    const int node = lanes_[replicaLane_[i]].numaNode;
+    if (node < 0) {
+      continue;
+    }
+    // pinned from here so that the placement is recorded only if it holds;
+    // the thread allocates nothing until its first batch
+    const std::string what = funcName_ + " forward thread " + std::to_string(i);
+    if (pinThreadToNode(forwardThreads_.back(), node)) {
+      recordPlacement(what, "node " + std::to_string(node));
+    } else {
+      std::cerr << "failed to pin " << what << " to node " << node
+                << std::endl;
+    }
+  }
+}
+
+void BatchProcessor::batchForward(int replica) {
+  ModelLocker& modelLocker = *modelLockers_[replica];
+  const torch::Device& device = devices_[replica];
+  Lane& lane = lanes_[replicaLane_[replica]];
+  Batcher& batcher = *lane.batcher;
+  const int numTurns = (int)lane.replicas.size();
+  const int myTurn = std::find(lane.replicas.begin(), lane.replicas.end(),
+                               replica) - lane.replicas.begin();
+
+  // Kept across batches: the jit input dict is refilled in place and device
+  // replies land in reusable pinned host tensors, one set per batch buffer.
+  TorchTensorDict inputDict;
+  TorchJitInput jitInput(1);
+  std::vector<TensorDict> replyStaging(batcher.numBuffers());
+
+  const metrics::Histogram getWaitUs(funcName_ + ".get_wait_us");
+  // fill ratio is batch_rows / batch_capacity
+  const metrics::Counter batchRows(funcName_ + ".batch_rows");
+  const metrics::Counter batchCapacity(funcName_ + ".batch_capacity");
+  const metrics::Histogram forwardUs(funcName_ + ".forward_us");
+
   while (running_) {
-    const TensorDict input = batcher_.get();
-    if (!input.empty()) {
-      auto output = modelForward(*modelLocker_, funcName_, input, device_);
-      batcher_.set(std::move(output));
+    int batchId = -1;
+    TensorDict input;
+    auto waitStart = std::chrono::steady_clock::now();
+    if (dispatch_ == Dispatch::ROUND_ROBIN && numTurns > 1) {
+      // only the replica holding the turn waits in get(), so the batch it
+      // returns is this replica's; mTurn is not held across the wait, and
+      // the turn is handed on once get() is back, even with an empty batch
+      {
+        std::unique_lock<std::mutex> lk(lane.mTurn);
+        lane.cvTurn.wait(lk, [&] { return lane.turn == myTurn || !running_; });
+        if (!running_) {
+          break;
+        }
+      }
+      input = batcher.get(&batchId);
+      {
+        std::lock_guard<std::mutex> lk(lane.mTurn);
+        lane.turn = (lane.turn + 1) % numTurns;
+      }
+      lane.cvTurn.notify_all();
+    } else {
+      input = batcher.get(&batchId);
+    }
+    if (input.empty()) {
+      continue;
     }
+    getWaitUs.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now() - waitStart)
+                         .count());
+    batchRows.add(input.begin()->second.size(0));
+    batchCapacity.add(batcher.batchsize());
+
+    metrics::ScopedTimer timer(forwardUs);
+    utils::tensorDictToTorchDict(input, device, inputDict);
+    jitInput[0] = inputDict;
+    auto jitOutput = modelForwardRaw(modelLocker, funcName_, jitInput);
+    batcher.set(batchId,
+                utils::iValueToTensorDict(jitOutput, replyStaging[batchId]));
   }
 }
 
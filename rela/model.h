@@ -6,54 +6,143 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <torch/script.h>
 
 #include "rela/batcher.h"
 #include "rela/model_common.h"
 #include "rela/static_batcher.h"
+#include "rela/topology.h"
 
 namespace rela {
 
+// How batches are spread over the replicas of a BatchProcessor.
+enum class Dispatch {
+  // idle forward threads pull the next ready batch.
+  LEAST_LOADED,
+  // replicas take batches in turn.
+  ROUND_ROBIN,
+};
+
+// Where a BatchProcessor runs, by NUMA node as numbered in Topology.
+struct Placement {
+  // node of the forward threads and the batch buffers, -1 leaves it to the
+  // OS.
+  int numaNode = -1;
+  // one batcher per node, served by the replicas on that node: replica i
+  // runs on node i % numNodes, and callers send to the batcher of the node
+  // they are running on. Overrides numaNode.
+  bool batcherPerNode = false;
+};
+
 // Wrapper of multiple models and call with keys.
 class BatchProcessor {
  public:
   BatchProcessor(std::shared_ptr<ModelLocker> modelLocker,
                  const std::string& funcName, int batchsize,
-                 const std::string& device)
-      : modelLocker_(modelLocker),
-        funcName_(funcName),
-        batcher_(batchsize),
-        device_(torch::Device(device)),
-        forwardThread_(&BatchProcessor::batchForward, this) {}
+                 const std::string& device, int maxWaitUs = 0,
+                 int numBuffers = 2)
+      : BatchProcessor({std::move(modelLocker)}, {torch::Device(device)},
+                       funcName, batchsize, Dispatch::LEAST_LOADED, maxWaitUs,
+                       numBuffers, Placement()) {}
+
+  // One forward thread per model locker (replica), each on that locker's
+  // device, all serving the same batcher (or the batcher of their node, see
+  // Placement).
+  BatchProcessor(std::vector<std::shared_ptr<ModelLocker>> modelLockers,
+                 const std::string& funcName, int batchsize,
+                 Dispatch dispatch = Dispatch::LEAST_LOADED,
+                 int maxWaitUs = 0, int numBuffers = 2,
+                 Placement placement = Placement())
+      : BatchProcessor(modelLockers, lockerDevices(modelLockers), funcName,
+                       batchsize, dispatch, maxWaitUs, numBuffers,
+                       placement) {}
 
   ~BatchProcessor() {
-    batcher_.exit();
+    for (auto& lane : lanes_) {
+      lane.batcher->exit();
+    }
     running_ = false;
-    forwardThread_.join();
+    for (auto& lane : lanes_) {
+      {
+        std::lock_guard<std::mutex> lk(lane.mTurn);
+      }
+      lane.cvTurn.notify_all();
+    }
+    for (auto& t : forwardThreads_) {
+      t.join();
+    }
   }
 
   template <typename... Args>
   TensorDict forward(Args... args) {
     TorchJitInput jitInput;
-    addToJitInput(device_, jitInput, args...);
-    return modelForward(*modelLocker_, funcName_, jitInput);
+    addToJitInput(devices_[0], jitInput, args...);
+    return modelForward(*modelLockers_[0], funcName_, jitInput);
+  }
+
+  // with a batcher per node, the one of the node the caller runs on
+  Batcher& batcher() {
+    if (lanes_.size() == 1) {
+      return *lanes_[0].batcher;
+    }
+    const int node = Topology::get().currentNode();
+    return *lanes_[std::max(node, 0) % lanes_.size()].batcher;
+  }
+
+  int numBatchers() const { return (int)lanes_.size(); }
+
+  void setDraining(bool draining) {
+    for (auto& lane : lanes_) {
+      lane.batcher->setDraining(draining);
+    }
   }
 
-  Batcher& batcher() { return batcher_; }
+  int numReplicas() const { return (int)modelLockers_.size(); }
 
   void processRequest() {}
 
  private:
-  void batchForward();
+  BatchProcessor(std::vector<std::shared_ptr<ModelLocker>> modelLockers,
+                 std::vector<torch::Device> devices,
+                 const std::string& funcName, int batchsize,
+                 Dispatch dispatch, int maxWaitUs, int numBuffers,
+                 Placement placement);
+
+  static std::vector<torch::Device> lockerDevices(
+      const std::vector<std::shared_ptr<ModelLocker>>& modelLockers) {
+    std::vector<torch::Device> devices;
+    for (const auto& locker : modelLockers) {
+      devices.push_back(locker->device());
+    }
+    return devices;
+  }
 
-  std::shared_ptr<ModelLocker> modelLocker_;
+  void batchForward(int replica);
+
+  std::vector<std::shared_ptr<ModelLocker>> modelLockers_;
+  const std::vector<torch::Device> devices_;
   const std::string funcName_;
-  Batcher batcher_;
-  torch::Device device_;
+  const Dispatch dispatch_;
+
+  // a batcher and the replicas serving it
+  struct Lane {
+    std::unique_ptr<Batcher> batcher;
+    int numaNode = -1;
+    std::vector<int> replicas;
+    // ROUND_ROBIN: index into replicas of the one taking the next batch,
+    // guarded by mTurn so that lanes don't wait on each other.
+    int turn = 0;
+    std::mutex mTurn;
+    std::condition_variable cvTurn;
+  };
+  std::vector<Lane> lanes_;
+  std::vector<int> replicaLane_;
 
   std::atomic<bool> running_{true};
-  std::thread forwardThread_;
+  std::vector<std::thread> forwardThreads_;
 };
 
 // Wrapper of multiple models and call with keys.
@@ -96,6 +185,41 @@ class Models {
     return sendAndGetFuture(processors_.at(callname)->batcher(), input);
   }
 
+  // input holds n rows, e.g. VectorEnv::feature(), sent as one request. The
+  // future returns the n reply rows.
+  std::function<TensorDict()> callBatch(const std::string& callname,
+                                        const TensorDict& input) {
+    RELA_CHECK(!input.empty());
+    const int n = input.begin()->second.size(0);
+    int slot = -1;
+    auto reply = processors_.at(callname)->batcher().send(input, n, &slot);
+    return [reply, slot, n]() { return reply->getRows(slot, n); };
+  }
+
+  // see Batcher::sendInPlace, nullptr until the call has seen a regular
+  // input and knows its shapes
+  template <class Writer>
+  std::function<TensorDict()> callInPlace(
+      const std::string& callname, const std::vector<std::string>& fields,
+      const Writer& write) {
+    int slot = -1;
+    auto reply =
+        processors_.at(callname)->batcher().sendInPlace(fields, write, &slot);
+    if (reply == nullptr) {
+      return nullptr;
+    }
+    return [reply, slot]() { return reply->get(slot); };
+  }
+
+  ReplyHandle callReply(const std::string& callname, const TensorDict& input) {
+    return sendAndGetReply(processors_.at(callname)->batcher(), input);
+  }
+
+  // resolve once, then use with ReplyHandle::get
+  int fieldId(const std::string& callname, const std::string& field) {
+    return processors_.at(callname)->batcher().fieldId(field);
+  }
+
   template <typename... Args>
   TensorDict callDirect(std::string callname, Args... args) {
     return processors_.at(callname)->forward(args...);
@@ -103,6 +227,13 @@ class Models {
 
   void processRequest();
 
+  // see Batcher::setDraining
+  void setDraining(bool draining) {
+    for (auto& it : processors_) {
+      it.second->setDraining(draining);
+    }
+  }
+
  private:
   std::unordered_map<std::string, std::shared_ptr<BatchProcessorUnit>>
       processors_;
@@ -3,6 +3,7 @@
 #include <math.h>
 #include <torch/script.h>
 
+#include "rela/batcher.h"
 #include "rela/model_locker.h"
 #include "rela/utils.h"
 
@@ -35,6 +36,15 @@ std::function<TensorDict()> sendAndGetFuture(BatchType& batcher,
   };
 }
 
+// Same as sendAndGetFuture but without building a TensorDict on the reply
+// side, fields are read through ids from batcher.fieldId().
+template <typename BatchType>
+ReplyHandle sendAndGetReply(BatchType& batcher, const TensorDict& input) {
+  int slot = -1;
+  auto reply = batcher.send(input, &slot);
+  return ReplyHandle(std::move(reply), slot);
+}
+
 template <typename T>
 void addOneToJitInput(const torch::Device& device, TorchJitInput &jitInput, T v) {
   jitInput.push_back(v);
@@ -54,16 +64,22 @@ void addToJitInput(const torch::Device& device, TorchJitInput &jitInput, T input
   addToJitInput(device, jitInput, args...);
 }
 
-inline TensorDict modelForward(ModelLocker& modelLocker,
-                               const std::string func_name,
-                               TorchJitInput &jitInput) {
+inline TorchJitOutput modelForwardRaw(ModelLocker& modelLocker,
+                                      const std::string& func_name,
+                                      TorchJitInput& jitInput) {
   torch::NoGradGuard noGrad;
 
   int id = -1;
   auto model = modelLocker.getModel(&id);
   TorchJitOutput jitOutput = model.get_method(func_name)(jitInput);
   modelLocker.releaseModel(id);
+  return jitOutput;
+}
 
+inline TensorDict modelForward(ModelLocker& modelLocker,
+                               const std::string func_name,
+                               TorchJitInput &jitInput) {
+  TorchJitOutput jitOutput = modelForwardRaw(modelLocker, func_name, jitInput);
   return utils::iValueToTensorDict(jitOutput, torch::kCPU, true);
 }
 
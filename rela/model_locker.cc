@@ -1,5 +1,7 @@
 #include "rela/model_locker.h"
 
+#include <thread>
+
 #include "rela/logging.h"
 
 namespace rela {
@@ -8,7 +10,7 @@ ModelLocker::ModelLocker(const std::vector<pybind11::object>& pyModels,
                          const std::string& device)
     : device_(torch::Device(device)),
       pyModels_(pyModels),
-      modelCallCounts_(pyModels.size(), 0),
+      modelCallCounts_(pyModels.size()),
       modelIndex_(0) {
   RELA_CHECK(!pyModels_.empty());
   models_.reserve(pyModels_.size());
@@ -18,31 +20,51 @@ ModelLocker::ModelLocker(const std::vector<pybind11::object>& pyModels,
 }
 
 void ModelLocker::updateModel(const pybind11::object& pyModel) {
-  std::unique_lock<std::mutex> lk(m_);
-  const int idx = (modelIndex_ + 1) % modelCallCounts_.size();
-  cv_.wait(lk, [this, idx] { return modelCallCounts_[idx] == 0; });
-  lk.unlock();
+  std::lock_guard<std::mutex> lk(mUpdate_);
+  const int numModel = (int)models_.size();
+  const int current = modelIndex_.load();
 
-  pyModels_[idx].attr("load_state_dict")(pyModel.attr("state_dict")());
+  // any copy but the published one, as soon as its last forward returns.
+  // With a single copy we can only wait for it to drain.
+  const int numCandidate = numModel > 1 ? numModel - 1 : 1;
+  int idx = -1;
+  {
+    pybind11::gil_scoped_release release;
+    while (idx < 0) {
+      for (int k = 1; k <= numCandidate; ++k) {
+        const int i = (current + k) % numModel;
+        if (modelCallCounts_[i].load() == 0) {
+          idx = i;
+          break;
+        }
+      }
+      if (idx < 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
 
-  lk.lock();
-  modelIndex_ = idx;
-  lk.unlock();
+  // A getModel that read a stale index may still bump modelCallCounts_[idx],
+  // but it re-checks modelIndex_ and backs off before touching the model.
+  pyModels_[idx].attr("load_state_dict")(pyModel.attr("state_dict")());
+  modelIndex_.store(idx);
 }
 
 const TorchJitModel& ModelLocker::getModel(int* idx) {
-  std::lock_guard<std::mutex> lk(m_);
-  *idx = modelIndex_;
-  ++modelCallCounts_[modelIndex_];
-  return *models_[modelIndex_];
+  while (true) {
+    const int i = modelIndex_.load();
+    ++modelCallCounts_[i];
+    if (modelIndex_.load() == i) {
+      *idx = i;
+      return *models_[i];
+    }
+    // an update was published in between, retry on the new copy
+    --modelCallCounts_[i];
+  }
 }
 
 void ModelLocker::releaseModel(int idx) {
-  std::unique_lock<std::mutex> lk(m_);
   --modelCallCounts_[idx];
-  if (modelCallCounts_[idx] == 0) {
-    cv_.notify_one();
-  }
 }
 
 }  // namespace rela
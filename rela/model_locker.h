@@ -2,7 +2,9 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -20,8 +22,11 @@ class ModelLocker {
 
   const torch::Device& device() const { return device_; }
 
+  // Loads pyModel's weights into a copy no forward is using, then publishes
+  // it. Forwards already running keep the weights they started with.
   void updateModel(const pybind11::object& pyModel);
 
+  // Lock free, safe to call from every forward.
   const TorchJitModel& getModel(int* idx);
 
   void releaseModel(int idx);
@@ -29,12 +34,14 @@ class ModelLocker {
  private:
   const torch::Device device_;
   std::vector<pybind11::object> pyModels_;
-  std::vector<int> modelCallCounts_;
-  int modelIndex_;
+  // number of forwards running on each copy
+  std::vector<std::atomic<int>> modelCallCounts_;
+  // copy handed out by getModel
+  std::atomic<int> modelIndex_;
 
   std::vector<TorchJitModel*> models_;
-  std::mutex m_;
-  std::condition_variable cv_;
+  // serializes updateModel callers
+  std::mutex mUpdate_;
 };
 
 }  // namespace rela
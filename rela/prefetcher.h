@@ -0,0 +1,105 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rela {
+
+// Persistent workers that keep up to depth results of produce() ready ahead
+// of the consumer. Workers run produce() concurrently, so it has to do its
+// own locking; results are handed out in completion order. An exception
+// thrown by produce() is rethrown by the get() that would have returned its
+// result.
+template <class T>
+class Prefetcher {
+ public:
+  Prefetcher(int depth, std::function<T()> produce)
+      : depth_(depth)
+      , produce_(std::move(produce)) {
+    for (int i = 0; i < depth_; ++i) {
+      workers_.emplace_back([this]() { workerLoop(); });
+    }
+  }
+
+  Prefetcher(const Prefetcher&) = delete;
+  Prefetcher& operator=(const Prefetcher&) = delete;
+
+  ~Prefetcher() {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      stop_ = true;
+    }
+    cvProduce_.notify_all();
+    for (auto& t : workers_) {
+      t.join();
+    }
+  }
+
+  T get() {
+    std::unique_lock<std::mutex> lk(m_);
+    cvReady_.wait(lk, [this] { return !ready_.empty() || !errors_.empty(); });
+    if (!errors_.empty()) {
+      std::exception_ptr error = errors_.front();
+      errors_.pop_front();
+      lk.unlock();
+      cvProduce_.notify_one();
+      std::rethrow_exception(error);
+    }
+    T result = std::move(ready_.front());
+    ready_.pop_front();
+    lk.unlock();
+    cvProduce_.notify_one();
+    return result;
+  }
+
+ private:
+  void workerLoop() {
+    std::unique_lock<std::mutex> lk(m_);
+    while (true) {
+      cvProduce_.wait(lk, [this] {
+        return stop_ ||
+               numPending_ + (int)(ready_.size() + errors_.size()) < depth_;
+      });
+      if (stop_) {
+        return;
+      }
+      ++numPending_;
+      lk.unlock();
+      // an escaping exception would terminate the process
+      try {
+        T result = produce_();
+        lk.lock();
+        ready_.push_back(std::move(result));
+      } catch (...) {
+        if (!lk.owns_lock()) {
+          lk.lock();
+        }
+        errors_.push_back(std::current_exception());
+      }
+      --numPending_;
+      cvReady_.notify_one();
+    }
+  }
+
+  const int depth_;
+  const std::function<T()> produce_;
+
+  std::mutex m_;
+  std::condition_variable cvProduce_;
+  std::condition_variable cvReady_;
+  bool stop_ = false;
+  int numPending_ = 0;
+  std::deque<T> ready_;
+  std::deque<std::exception_ptr> errors_;
+
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace rela
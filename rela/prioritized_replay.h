@@ -2,11 +2,15 @@
 
 #pragma once
 
-#include <future>
+#include <memory>
 #include <random>
+#include <string>
 #include <torch/extension.h>
 #include <vector>
 
+#include "rela/metrics.h"
+#include "rela/prefetcher.h"
+#include "rela/sum_tree.h"
 #include "rela/types.h"
 
 namespace rela {
@@ -21,16 +25,15 @@ class ConcurrentQueue {
       , size_(0)
       , safeTail_(0)
       , safeSize_(0)
-      , sum_(0)
       , evicted_(capacity, false)
       , elements_(capacity)
-      , weights_(capacity, 0) {
+      , tree_(capacity) {
   }
 
   int safeSize(float* sum) const {
     std::unique_lock<std::mutex> lk(m_);
     if (sum != nullptr) {
-      *sum = sum_;
+      *sum = tree_.total();
     }
     return safeSize_;
   }
@@ -56,22 +59,22 @@ class ConcurrentQueue {
 
     lk.unlock();
 
-    float sum = 0;
     auto weightAcc = weights.accessor<float, 1>();
     assert(weightAcc.size(0) == blockSize);
     for (int i = 0; i < blockSize; ++i) {
       int j = (start + i) % capacity;
       elements_[j] = block[i];
-      weights_[j] = weightAcc[i];
-      sum += weightAcc[i];
     }
 
     lk.lock();
 
     cvTail_.wait(lk, [=] { return safeTail_ == start; });
+    // weights only enter the tree once the elements are safe to sample
+    for (int i = 0; i < blockSize; ++i) {
+      tree_.set((start + i) % capacity, weightAcc[i]);
+    }
     safeTail_ = end;
     safeSize_ += blockSize;
-    sum_ += sum;
     checkSize(head_, safeTail_, safeSize_);
 
     lk.unlock();
@@ -79,21 +82,18 @@ class ConcurrentQueue {
   }
 
   // ------------------------------------------------------------- //
-  // blockPop, update are thread-safe against blockAppend
+  // blockPop, update, sampleIds are thread-safe against blockAppend
   // but they are NOT thread-safe against each other
 
   void blockPop(int blockSize) {
-    double diff = 0;
-    int head = head_;
-    for (int i = 0; i < blockSize; ++i) {
-      diff -= weights_[head];
-      evicted_[head] = true;
-      head = (head + 1) % capacity;
-    }
-
     {
       std::lock_guard<std::mutex> lk(m_);
-      sum_ += diff;
+      int head = head_;
+      for (int i = 0; i < blockSize; ++i) {
+        tree_.set(head, 0);
+        evicted_[head] = true;
+        head = (head + 1) % capacity;
+      }
       head_ = head;
       safeSize_ -= blockSize;
       size_ -= blockSize;
@@ -104,36 +104,50 @@ class ConcurrentQueue {
   }
 
   void update(const std::vector<int>& ids, const torch::Tensor& weights) {
-    double diff = 0;
     auto weightAcc = weights.accessor<float, 1>();
+    std::lock_guard<std::mutex> lk(m_);
     for (int i = 0; i < (int)ids.size(); ++i) {
       auto id = ids[i];
       if (evicted_[id]) {
         continue;
       }
-      diff += (weightAcc[i] - weights_[id]);
-      weights_[id] = weightAcc[i];
+      tree_.set(id, weightAcc[i]);
     }
+  }
 
-    std::lock_guard<std::mutex> lk_(m_);
-    sum_ += diff;
+  // stratified sampling, one id from each of batchsize equal slices of
+  // the total weight. returns safe size
+  int sampleIds(int batchsize,
+                std::mt19937& rng,
+                std::vector<int>* ids,
+                std::vector<float>* weights,
+                float* sum) {
+    std::lock_guard<std::mutex> lk(m_);
+    const double total = tree_.total();
+    assert(safeSize_ > 0 && total > 0);
+
+    const double segment = total / batchsize;
+    std::uniform_real_distribution<double> dist(0.0, segment);
+    ids->resize(batchsize);
+    weights->resize(batchsize);
+    for (int i = 0; i < batchsize; ++i) {
+      double rand = std::min(dist(rng) + i * segment, total);
+      int id = tree_.find(rand);
+      (*ids)[i] = id;
+      (*weights)[i] = tree_.get(id);
+    }
+    *sum = total;
+    return safeSize_;
   }
 
   // ------------------------------------------------------------- //
   // accessing elements is never locked, operate safely!
 
-  DataType getElementAndMark(int idx) {
-    int id = (head_ + idx) % capacity;
+  DataType getElementAndMark(int id) {
     evicted_[id] = false;
     return elements_[id];
   }
 
-  float getWeight(int idx, int* id) {
-    assert(id != nullptr);
-    *id = (head_ + idx) % capacity;
-    return weights_[*id];
-  }
-
   const int capacity;
 
  private:
@@ -165,11 +179,11 @@ class ConcurrentQueue {
 
   int safeTail_;
   int safeSize_;
-  double sum_;
   std::vector<bool> evicted_;
 
   std::vector<DataType> elements_;
-  std::vector<float> weights_;
+  // sampling weights, zero outside [head_, safeTail_)
+  SumTree tree_;
 };
 
 template <class DataType>
@@ -187,6 +201,8 @@ class PrioritizedReplay {
   }
 
   void add(const std::vector<DataType>& sample, const torch::Tensor& priority) {
+    static const metrics::Histogram addUs("replay.add_us");
+    metrics::ScopedTimer timer(addUs);
     assert(priority.dim() == 1);
     auto weights = torch::pow(priority, alpha_);
     storage_.blockAppend(sample, weights);
@@ -204,6 +220,8 @@ class PrioritizedReplay {
 
   std::tuple<DataType, torch::Tensor> sample(int batchsize,
                                              const std::string& device) {
+    static const metrics::Histogram sampleUs("replay.sample_us");
+    metrics::ScopedTimer timer(sampleUs);
     if (!sampledIds_.empty()) {
       std::cout << "Error: previous samples' priority has not been updated."
                 << std::endl;
@@ -217,23 +235,18 @@ class PrioritizedReplay {
       return std::make_tuple(batch, priority);
     }
 
-    if (futures_.empty()) {
-      std::tie(batch, priority, sampledIds_) = sample_(batchsize, device);
-    } else {
-      // assert(futures_.size() == 1);
-      std::tie(batch, priority, sampledIds_) = futures_.front().get();
-      futures_.pop();
-    }
-
-    while ((int)futures_.size() < prefetch_) {
-      auto f = std::async(std::launch::async,
-                          &PrioritizedReplay<DataType>::sample_,
-                          this,
-                          batchsize,
-                          device);
-      futures_.push(std::move(f));
+    if (prefetcher_ == nullptr || batchsize != prefetchBatchsize_ ||
+        device != prefetchDevice_) {
+      prefetcher_.reset();
+      prefetchBatchsize_ = batchsize;
+      prefetchDevice_ = device;
+      prefetcher_ = std::make_unique<Prefetcher<SampleWeightIds>>(
+          prefetch_, [this, batchsize, device]() {
+            return sample_(batchsize, device);
+          });
     }
 
+    std::tie(batch, priority, sampledIds_) = prefetcher_->get();
     return std::make_tuple(batch, priority);
   }
 
@@ -269,57 +282,22 @@ class PrioritizedReplay {
     std::unique_lock<std::mutex> lk(mSampler_);
 
     float sum;
-    int size = storage_.safeSize(&sum);
-    // std::cout << "size: "<< size << ", sum: " << sum << std::endl;
-    // storage_ [0, size) remains static in the subsequent section
-
-    float segment = sum / batchsize;
-    std::uniform_real_distribution<float> dist(0.0, segment);
+    std::vector<int> ids;
+    std::vector<float> sampled;
+    storage_.sampleIds(batchsize, rng_, &ids, &sampled, &sum);
 
     std::vector<DataType> samples;
+    samples.reserve(batchsize);
     auto weights = torch::zeros({batchsize}, torch::kFloat32);
     auto weightAcc = weights.accessor<float, 1>();
-    std::vector<int> ids(batchsize);
-
-    double accSum = 0;
-    int nextIdx = 0;
-    float w = 0;
-    int id = 0;
     for (int i = 0; i < batchsize; i++) {
-      float rand = dist(rng_) + i * segment;
-      rand = std::min(sum - (float)0.1, rand);
-      // std::cout << "looking for " << i << "th/" << batchsize << " sample" <<
-      // std::endl;
-      // std::cout << "\ttarget: " << rand << std::endl;
-
-      while (nextIdx <= size) {
-        if (accSum > 0 && accSum >= rand) {
-          assert(nextIdx >= 1);
-          // std::cout << "\tfound: " << nextIdx - 1 << ", " << id << ", " <<
-          // accSum << std::endl;
-          DataType element = storage_.getElementAndMark(nextIdx - 1);
-          samples.push_back(element);
-          weightAcc[i] = w;
-          ids[i] = id;
-          break;
-        }
-
-        if (nextIdx == size) {
-          std::cout << "nextIdx: " << nextIdx << "/" << size << std::endl;
-          std::cout << std::setprecision(10) << "accSum: " << accSum
-                    << ", sum: " << sum << ", rand: " << rand << std::endl;
-          assert(false);
-        }
-
-        w = storage_.getWeight(nextIdx, &id);
-        accSum += w;
-        ++nextIdx;
-      }
+      samples.push_back(storage_.getElementAndMark(ids[i]));
+      weightAcc[i] = sampled[i];
     }
     assert((int)samples.size() == batchsize);
 
     // pop storage if full
-    size = storage_.size();
+    int size = storage_.size();
     if (size > capacity_) {
       storage_.blockPop(size - capacity_);
     }
@@ -348,9 +326,13 @@ class PrioritizedReplay {
   // make sure that sample & update does not overlap
   std::mutex mSampler_;
   std::vector<int> sampledIds_;
-  std::queue<std::future<SampleWeightIds>> futures_;
 
   std::mt19937 rng_;
+
+  // persistent prefetch workers, declared last so they stop first
+  int prefetchBatchsize_ = 0;
+  std::string prefetchDevice_;
+  std::unique_ptr<Prefetcher<SampleWeightIds>> prefetcher_;
 };
 
 using FFPrioritizedReplay = PrioritizedReplay<FFTransition>;
@@ -5,16 +5,25 @@
 #include <chrono>
 using namespace std::chrono;
 
-#include <future>
+#include <memory>
 #include <random>
+#include <string>
 #include <torch/extension.h>
+#include <unordered_map>
 #include <vector>
 
+#include "rela/logging.h"
+#include "rela/metrics.h"
+#include "rela/prefetcher.h"
+#include "rela/replay_snapshot.h"
+#include "rela/replay_storage.h"
+#include "rela/sum_tree.h"
 #include "rela/types.h"
 
 namespace rela {
 
-template <class DataType>
+// Slot and priority bookkeeping of one replay ring. The elements live in a
+// ReplayStorage owned by the replay, written through blockAppend's writer.
 class ConcurrentQueueNew {
  public:
   ConcurrentQueueNew(int capacity)
@@ -24,16 +33,14 @@ class ConcurrentQueueNew {
       , size_(0)
       , safeTail_(0)
       , safeSize_(0)
-      , sum_(0)
       , evicted_(capacity, false)
-      , elements_(capacity)
-      , weights_(capacity, 0) {
+      , tree_(capacity) {
   }
 
   int safeSize(float* sum) const {
     std::unique_lock<std::mutex> lk(m_);
     if (sum != nullptr) {
-      *sum = sum_;
+      *sum = tree_.total();
     }
     return safeSize_;
   }
@@ -43,9 +50,15 @@ class ConcurrentQueueNew {
     return size_;
   }
 
-  void blockAppend(const std::vector<DataType>& block,
-                   const torch::Tensor& weights) {
-    int blockSize = block.size();
+  double sum() const {
+    std::unique_lock<std::mutex> lk(m_);
+    return tree_.total();
+  }
+
+  // write(i, slot) stores the i-th element of the block into slot
+  template <class Writer>
+  void blockAppend(const torch::Tensor& weights, const Writer& write) {
+    int blockSize = weights.size(0);
 
     std::unique_lock<std::mutex> lk(m_);
     cvSize_.wait(lk, [=] { return size_ + blockSize <= capacity; });
@@ -59,44 +72,64 @@ class ConcurrentQueueNew {
 
     lk.unlock();
 
-    float sum = 0;
     auto weightAcc = weights.accessor<float, 1>();
-    assert(weightAcc.size(0) == blockSize);
     for (int i = 0; i < blockSize; ++i) {
-      int j = (start + i) % capacity;
-      elements_[j] = block[i];
-      weights_[j] = weightAcc[i];
-      sum += weightAcc[i];
+      write(i, (start + i) % capacity);
     }
 
     lk.lock();
 
     cvTail_.wait(lk, [=] { return safeTail_ == start; });
+    // weights only enter the tree once the elements are safe to sample
+    for (int i = 0; i < blockSize; ++i) {
+      tree_.set((start + i) % capacity, weightAcc[i]);
+    }
     safeTail_ = end;
     safeSize_ += blockSize;
-    sum_ += sum;
     checkSize(head_, safeTail_, safeSize_);
 
     lk.unlock();
     cvTail_.notify_all();
   }
 
+  // copy of the committed state, leaves must hold capacity floats.
+  // blocks in flight are left out, their slots have zero weight
+  void snapshot(int* head, int* tail, int* size, float* leaves) const {
+    std::lock_guard<std::mutex> lk(m_);
+    *head = head_;
+    *tail = safeTail_;
+    *size = safeSize_;
+    for (int i = 0; i < capacity; ++i) {
+      leaves[i] = tree_.get(i);
+    }
+  }
+
+  // inverse of snapshot(), only valid on an empty queue
+  void restore(int head, int tail, int size, const float* leaves) {
+    std::lock_guard<std::mutex> lk(m_);
+    RELA_CHECK_EQ(size_, 0, "restoring into a non-empty replay");
+    head_ = head;
+    tail_ = tail;
+    safeTail_ = tail;
+    size_ = size;
+    safeSize_ = size;
+    checkSize(head_, safeTail_, safeSize_);
+    tree_.assign(leaves);
+  }
+
   // ------------------------------------------------------------- //
-  // blockPop, update are thread-safe against blockAppend
+  // blockPop, update, findIds are thread-safe against blockAppend
   // but they are NOT thread-safe against each other
 
   void blockPop(int blockSize) {
-    double diff = 0;
-    int head = head_;
-    for (int i = 0; i < blockSize; ++i) {
-      diff -= weights_[head];
-      evicted_[head] = true;
-      head = (head + 1) % capacity;
-    }
-
     {
       std::lock_guard<std::mutex> lk(m_);
-      sum_ += diff;
+      int head = head_;
+      for (int i = 0; i < blockSize; ++i) {
+        tree_.set(head, 0);
+        evicted_[head] = true;
+        head = (head + 1) % capacity;
+      }
       head_ = head;
       safeSize_ -= blockSize;
       size_ -= blockSize;
@@ -106,35 +139,34 @@ class ConcurrentQueueNew {
     cvSize_.notify_all();
   }
 
-  void update(const std::vector<int>& ids, const torch::Tensor& weights) {
-    double diff = 0;
-    auto weightAcc = weights.accessor<float, 1>();
+  void update(const std::vector<int>& ids, const std::vector<float>& weights) {
+    assert(ids.size() == weights.size());
+    std::lock_guard<std::mutex> lk(m_);
     for (int i = 0; i < (int)ids.size(); ++i) {
       auto id = ids[i];
       if (evicted_[id]) {
         continue;
       }
-      diff += (weightAcc[i] - weights_[id]);
-      weights_[id] = weightAcc[i];
+      tree_.set(id, weights[i]);
     }
-
-    std::lock_guard<std::mutex> lk_(m_);
-    sum_ += diff;
   }
 
-  // ------------------------------------------------------------- //
-  // accessing elements is never locked, operate safely!
-
-  DataType getElementAndMark(int idx) {
-    int id = (head_ + idx) % capacity;
-    evicted_[id] = false;
-    return elements_[id];
-  }
-
-  float getWeight(int idx, int* id) {
-    assert(id != nullptr);
-    *id = (head_ + idx) % capacity;
-    return weights_[*id];
+  // look up the slot under each prefix sum of the weights, all under one lock,
+  // and mark them live for update(). prefixes must be within sum(), which
+  // only grows until the next blockPop
+  void findIds(const std::vector<double>& prefixes,
+               std::vector<int>* ids,
+               std::vector<float>* weights) {
+    std::lock_guard<std::mutex> lk(m_);
+    assert(tree_.total() > 0);
+    ids->resize(prefixes.size());
+    weights->resize(prefixes.size());
+    for (int i = 0; i < (int)prefixes.size(); ++i) {
+      int id = tree_.find(prefixes[i]);
+      evicted_[id] = false;
+      (*ids)[i] = id;
+      (*weights)[i] = tree_.get(id);
+    }
   }
 
   const int capacity;
@@ -168,33 +200,52 @@ class ConcurrentQueueNew {
 
   int safeTail_;
   int safeSize_;
-  double sum_;
   std::vector<bool> evicted_;
 
-  std::vector<DataType> elements_;
-  std::vector<float> weights_;
+  // sampling weights, zero outside [head_, safeTail_)
+  SumTree tree_;
 };
 
 template <class DataType>
 class PrioritizedReplayNew {
  public:
-  PrioritizedReplayNew(
-      int capacity, int seed, float alpha, float beta, int prefetch, int batchdim = 0)
+  // numShards > 1 splits the buffer into independent rings, each with its
+  // own lock and sum tree, so that producers on different shards never
+  // contend. sampling picks shards in proportion to their total priority.
+  PrioritizedReplayNew(int capacity,
+                       int seed,
+                       float alpha,
+                       float beta,
+                       int prefetch,
+                       int batchdim = 0,
+                       int numShards = 1)
       : alpha_(alpha)  // priority exponent
       , beta_(beta)    // importance sampling exponent
       , prefetch_(prefetch)
       , capacity_(capacity)
       , batchdim_(batchdim)
-      , storage_(int(1.25 * capacity))
+      , shardCapacity_((capacity + numShards - 1) / numShards)
+      , shardSlots_(int(1.25 * shardCapacity_))
+      , storage_(numShards * shardSlots_)
       , numAdd_(0) {
+    assert(numShards >= 1);
+    for (int i = 0; i < numShards; ++i) {
+      shards_.push_back(std::make_unique<ConcurrentQueueNew>(shardSlots_));
+    }
     rng_.seed(seed);
   }
 
   void add(const std::vector<DataType>& sample, const torch::Tensor& priority) {
+    static const metrics::Histogram addUs("replay.add_us");
+    metrics::ScopedTimer timer(addUs);
     assert(priority.dim() == 1);
     assert(priority.size(0) == (int)sample.size());
     auto weights = torch::pow(priority, alpha_);
-    storage_.blockAppend(sample, weights);
+    int shard = producerId() % shards_.size();
+    int offset = shard * shardSlots_;
+    shards_[shard]->blockAppend(weights, [&](int i, int slot) {
+      storage_.write(offset + slot, sample[i]);
+    });
     numAdd_ += priority.size(0);
   }
 
@@ -206,6 +257,8 @@ class PrioritizedReplayNew {
 
   std::tuple<DataType, torch::Tensor> sample(int batchsize,
                                              const std::string& device) {
+    static const metrics::Histogram sampleUs("replay.sample_us");
+    metrics::ScopedTimer timer(sampleUs);
     if (!sampledIds_.empty()) {
       std::cout << "Error: previous samples' priority has not been updated."
                 << std::endl;
@@ -219,23 +272,22 @@ class PrioritizedReplayNew {
       return std::make_tuple(batch, priority);
     }
 
-    if (futures_.empty()) {
-      std::tie(batch, priority, sampledIds_) = sample_(batchsize, device);
-    } else {
-      // assert(futures_.size() == 1);
-      std::tie(batch, priority, sampledIds_) = futures_.front().get();
-      futures_.pop();
-    }
-
-    while ((int)futures_.size() < prefetch_) {
-      auto f = std::async(std::launch::async,
-                          &PrioritizedReplayNew<DataType>::sample_,
-                          this,
-                          batchsize,
-                          device);
-      futures_.push(std::move(f));
+    if (prefetcher_ == nullptr || batchsize != prefetchBatchsize_ ||
+        device != prefetchDevice_) {
+      // batches prefetched for other arguments are dropped unseen
+      prefetcher_.reset();
+      prefetchBatchsize_ = batchsize;
+      prefetchDevice_ = device;
+      prefetcher_ = std::make_unique<Prefetcher<SampleWeightIds>>(
+          prefetch_, [this, batchsize, device]() {
+            return sample_(batchsize, device);
+          });
     }
 
+    auto start = Clock::now();
+    std::tie(batch, priority, sampledIds_) = prefetcher_->get();
+    waitUs_ += usSince(start);
+    ++numWait_;
     return std::make_tuple(batch, priority);
   }
 
@@ -244,9 +296,22 @@ class PrioritizedReplayNew {
     assert((int)sampledIds_.size() == priority.size(0));
 
     auto weights = torch::pow(priority, alpha_);
+    auto weightAcc = weights.accessor<float, 1>();
+    const int numShards = shards_.size();
+    std::vector<std::vector<int>> ids(numShards);
+    std::vector<std::vector<float>> shardWeights(numShards);
+    for (int i = 0; i < (int)sampledIds_.size(); ++i) {
+      int shard = sampledIds_[i] / shardSlots_;
+      ids[shard].push_back(sampledIds_[i] % shardSlots_);
+      shardWeights[shard].push_back(weightAcc[i]);
+    }
     {
       std::lock_guard<std::mutex> lk(mSampler_);
-      storage_.update(sampledIds_, weights);
+      for (int s = 0; s < numShards; ++s) {
+        if (!ids[s].empty()) {
+          shards_[s]->update(ids[s], shardWeights[s]);
+        }
+      }
     }
     sampledIds_.clear();
   }
@@ -256,103 +321,206 @@ class PrioritizedReplayNew {
   }
 
   int size() const {
-    return storage_.safeSize(nullptr);
+    int size = 0;
+    for (const auto& shard : shards_) {
+      size += shard->safeSize(nullptr);
+    }
+    return size;
   }
 
   int numAdd() const {
     return numAdd_;
   }
 
+  // average microseconds per batch of each sampling stage: select (lock,
+  // index selection and gather), assemble (importance weights) and upload
+  // (host to device), plus how long sample() waited for a prefetched batch
+  std::unordered_map<std::string, float> sampleStats() const {
+    float numBatch = std::max<int64_t>(numBatch_, 1);
+    return {
+        {"select", selectUs_ / numBatch},
+        {"assemble", assembleUs_ / numBatch},
+        {"upload", uploadUs_ / numBatch},
+        {"wait", waitUs_ / (float)std::max<int64_t>(numWait_, 1)},
+        {"num_batch", (float)numBatch_},
+    };
+  }
+
+  // Writes contents, priorities and ring state to path. The ring state and
+  // priorities are copied under the sampler lock; the columns are written
+  // after it is released, while sampling goes on. Slots of the snapshot's
+  // [head, tail) are only reused after a pop, so sample_() does not pop
+  // until the write is done: producers keep adding into the free slots and
+  // block only once those run out. Their blocks in flight are simply not
+  // part of the snapshot.
+  void save(const std::string& path) {
+    ReplaySnapshot snapshot;
+    {
+      std::lock_guard<std::mutex> lk(mSampler_);
+      RELA_CHECK(!saving_, "another save() is running");
+      saving_ = true;
+      snapshotLocked(&snapshot);
+    }
+    try {
+      saveReplaySnapshot(path, snapshot);
+    } catch (...) {
+      std::lock_guard<std::mutex> lk(mSampler_);
+      saving_ = false;
+      throw;
+    }
+    std::lock_guard<std::mutex> lk(mSampler_);
+    saving_ = false;
+  }
+
+  // Maps a snapshot written by save() into this replay, which must be empty
+  // and built with the same capacity and number of shards. Elements are
+  // paged in from the file as they are sampled.
+  void load(const std::string& path) {
+    auto snapshot = loadReplaySnapshot(path);
+    RELA_CHECK_EQ(snapshot.numShards, (int)shards_.size());
+    RELA_CHECK_EQ(snapshot.shardSlots, shardSlots_);
+
+    std::lock_guard<std::mutex> lk(mSampler_);
+    // checked before storage_ is replaced, so a failed load leaves the
+    // replay as it was
+    for (const auto& shard : shards_) {
+      RELA_CHECK_EQ(shard->size(), 0, "loading into a non-empty replay");
+    }
+    if (!snapshot.columns.empty()) {
+      storage_.assign(std::move(snapshot.columns));
+    }
+    const float* leaves = snapshot.leaves.data_ptr<float>();
+    for (int s = 0; s < snapshot.numShards; ++s) {
+      shards_[s]->restore(snapshot.heads[s],
+                          snapshot.tails[s],
+                          snapshot.sizes[s],
+                          leaves + s * shardSlots_);
+    }
+    numAdd_ = snapshot.numAdd;
+  }
+
  private:
   using SampleWeightIds = std::tuple<DataType, torch::Tensor, std::vector<int>>;
+  using Clock = std::chrono::steady_clock;
+
+  // ring state and priorities of every shard; the columns are shared, not
+  // copied
+  void snapshotLocked(ReplaySnapshot* snapshot) const {
+    snapshot->numShards = shards_.size();
+    snapshot->shardSlots = shardSlots_;
+    snapshot->numAdd = numAdd_;
+    snapshot->heads.resize(snapshot->numShards);
+    snapshot->tails.resize(snapshot->numShards);
+    snapshot->sizes.resize(snapshot->numShards);
+    snapshot->leaves =
+        torch::zeros({snapshot->numShards * shardSlots_}, torch::kFloat32);
+    float* leaves = snapshot->leaves.data_ptr<float>();
+    for (int s = 0; s < snapshot->numShards; ++s) {
+      shards_[s]->snapshot(&snapshot->heads[s],
+                           &snapshot->tails[s],
+                           &snapshot->sizes[s],
+                           leaves + s * shardSlots_);
+    }
+    snapshot->columns = storage_.columns();
+  }
 
+  static int64_t usSince(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               Clock::now() - start)
+        .count();
+  }
+
+  // stable per thread, so that a producer keeps appending to one shard
+  static int producerId() {
+    static std::atomic<int> counter(0);
+    thread_local int id = counter++;
+    return id;
+  }
+
+  // runs on several prefetch workers at once: only index selection and the
+  // gather hold mSampler_, assembly and upload overlap across workers
   SampleWeightIds sample_(int batchsize, const std::string& device) {
-    // auto start = high_resolution_clock::now();
+    auto start = Clock::now();
     std::unique_lock<std::mutex> lk(mSampler_);
 
-    float sum;
-    int size = storage_.safeSize(&sum);
-    // std::cout << "size: "<< size << ", sum: " << sum << std::endl;
-    // storage_ [0, size) remains static in the subsequent section
-
-    float segment = sum / batchsize;
-    std::uniform_real_distribution<float> dist(0.0, segment);
+    const int numShards = shards_.size();
+    std::vector<double> shardSums(numShards);
+    double sum = 0;
+    for (int s = 0; s < numShards; ++s) {
+      shardSums[s] = shards_[s]->sum();
+      sum += shardSums[s];
+    }
+    assert(sum > 0);
+
+    // stratified over the global sum, then routed to the owning shard.
+    // shards only grow until the blockPop below, so the prefixes stay valid
+    const double segment = sum / batchsize;
+    std::uniform_real_distribution<double> dist(0.0, segment);
+    std::vector<std::vector<double>> prefixes(numShards);
+    std::vector<std::vector<int>> slots(numShards);
+    for (int i = 0; i < batchsize; i++) {
+      double rand = std::min(dist(rng_) + i * segment, sum);
+      int s = 0;
+      while (s < numShards - 1 && (rand >= shardSums[s] || shardSums[s] <= 0)) {
+        rand -= shardSums[s];
+        ++s;
+      }
+      while (shardSums[s] <= 0) {
+        --s;
+      }
+      prefixes[s].push_back(std::min(rand, shardSums[s]));
+      slots[s].push_back(i);
+    }
 
-    std::vector<DataType> samples;
+    std::vector<int> ids(batchsize);
     auto weights = torch::zeros({batchsize}, torch::kFloat32);
     auto weightAcc = weights.accessor<float, 1>();
-    std::vector<int> ids(batchsize);
-
-    double accSum = 0;
-    int nextIdx = 0;
-    float w = 0;
-    int id = 0;
-    for (int i = 0; i < batchsize; i++) {
-      float rand = dist(rng_) + i * segment;
-      rand = std::min(sum - (float)0.2, rand);
-      // std::cout << "looking for " << i << "th/" << batchsize << " sample" <<
-      // std::endl;
-      // std::cout << "\ttarget: " << rand << std::endl;
-
-      while (nextIdx <= size) {
-        if (accSum > 0 && accSum >= rand) {
-          assert(nextIdx >= 1);
-          // std::cout << "\tfound: " << nextIdx - 1 << ", " << id << ", " <<
-          // accSum << std::endl;
-          DataType element = storage_.getElementAndMark(nextIdx - 1);
-          samples.push_back(element);
-          weightAcc[i] = w;
-          ids[i] = id;
-          break;
-        }
-
-        if (nextIdx == size) {
-          std::cout << "nextIdx: " << nextIdx << "/" << size << std::endl;
-          std::cout << std::setprecision(10) << "accSum: " << accSum
-                    << ", sum: " << sum << ", rand: " << rand << std::endl;
-          assert(false);
-        }
-
-        w = storage_.getWeight(nextIdx, &id);
-        accSum += w;
-        ++nextIdx;
+    std::vector<int> shardIds;
+    std::vector<float> shardWeights;
+    for (int s = 0; s < numShards; ++s) {
+      if (prefixes[s].empty()) {
+        continue;
+      }
+      auto& shard = *shards_[s];
+      shard.findIds(prefixes[s], &shardIds, &shardWeights);
+      for (int k = 0; k < (int)shardIds.size(); ++k) {
+        int i = slots[s][k];
+        weightAcc[i] = shardWeights[k];
+        ids[i] = s * shardSlots_ + shardIds[k];
       }
     }
-    assert((int)samples.size() == batchsize);
-
-    // pop storage if full
-    size = storage_.size();
-    if (size > capacity_) {
-      storage_.blockPop(size - capacity_);
+    // gather before blockPop so that no sampled slot can be reused meanwhile
+    const bool upload = device != "cpu";
+    auto batch = storage_.gather(ids, batchdim_, upload);
+
+    // pop storage if full, not while save() is writing
+    int size = 0;
+    for (auto& shard : shards_) {
+      int shardSize = shard->size();
+      if (shardSize > shardCapacity_ && !saving_) {
+        shard->blockPop(shardSize - shardCapacity_);
+        shardSize = shardCapacity_;
+      }
+      size += shardSize;
     }
 
-    // auto stop = high_resolution_clock::now();
-    // auto duration = duration_cast<microseconds>(stop - start);
-    // timer_["sample"] += duration.count();
-
-    // safe to unlock, because <samples> contains copys
+    // safe to unlock, because <batch> contains copys
     lk.unlock();
+    selectUs_ += usSince(start);
 
+    start = Clock::now();
     weights = weights / sum;
     weights = torch::pow(size * weights, -beta_);
     weights /= weights.max();
-    if (device != "cpu") {
+    assembleUs_ += usSince(start);
+
+    if (upload) {
+      start = Clock::now();
       weights = weights.to(torch::Device(device));
+      batch = batch.toDevice(device, true);
+      uploadUs_ += usSince(start);
     }
-    // start = high_resolution_clock::now();
-    auto batch = DataType::makeBatch(samples, batchdim_, device);
-    // stop = high_resolution_clock::now();
-    // duration = duration_cast<microseconds>(stop - start);
-    // timer_["combine"] += duration.count();
-    // counter_ += 1;
-    // if (counter_ % 1000 == 0)  {
-    //   std::cout << "===============" << std::endl;
-    //   for (auto& kv : timer_) {
-    //     std::cout << kv.first << ": " << kv.second / 1000 << std::endl;
-    //     timer_[kv.first] = 0;
-    //   }
-    //   std::cout << "===========" << std::endl;
-    // }
+    ++numBatch_;
     return std::make_tuple(batch, weights, ids);
   }
 
@@ -361,18 +529,32 @@ class PrioritizedReplayNew {
   const int prefetch_;
   const int capacity_;
   const int batchdim_;
+  const int shardCapacity_;
+  const int shardSlots_;
 
-  ConcurrentQueueNew<DataType> storage_;
+  std::vector<std::unique_ptr<ConcurrentQueueNew>> shards_;
+  ReplayStorage<DataType> storage_;
   std::atomic<int> numAdd_;
 
   // make sure that sample & update does not overlap
   std::mutex mSampler_;
+  // save() is writing the columns, guarded by mSampler_
+  bool saving_ = false;
   std::vector<int> sampledIds_;
-  std::queue<std::future<SampleWeightIds>> futures_;
 
   std::mt19937 rng_;
-  // std::map<std::string, float> timer_;
-  // int counter_ = 0;
+
+  std::atomic<int64_t> selectUs_{0};
+  std::atomic<int64_t> assembleUs_{0};
+  std::atomic<int64_t> uploadUs_{0};
+  std::atomic<int64_t> numBatch_{0};
+  std::atomic<int64_t> waitUs_{0};
+  std::atomic<int64_t> numWait_{0};
+
+  // last member, so its workers are joined before anything they use goes
+  int prefetchBatchsize_ = 0;
+  std::string prefetchDevice_;
+  std::unique_ptr<Prefetcher<SampleWeightIds>> prefetcher_;
 };
 
 using PrioritizedReplay2 = PrioritizedReplayNew<Transition>;
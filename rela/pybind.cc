@@ -9,6 +9,7 @@
 // #include "rela/dqn_actor.h"
 #include "rela/a2c_actor.h"
 #include "rela/env.h"
+#include "rela/metrics.h"
 #include "rela/model.h"
 #include "rela/prioritized_replay.h"
 #include "rela/r2d2_actor.h"
@@ -35,11 +36,21 @@ PYBIND11_MODULE(rela, m) {
                     float,  // beta, importance sampling exponent
                     bool,   // whther we do prefetch
                     int>())  //batchdim axis (usually it is 0, if we use LSTM then this can be 1)
+      .def(py::init<int,    // capacity,
+                    int,    // seed,
+                    float,  // alpha, priority exponent
+                    float,  // beta, importance sampling exponent
+                    int,    // #batches to prefetch, one worker each
+                    int,    // batchdim axis
+                    int>())  // number of shards, each with its own lock
       .def("size", &PrioritizedReplay2::size)
       .def("num_add", &PrioritizedReplay2::numAdd)
       .def("sample", &PrioritizedReplay2::sample)
       .def("update_priority", &PrioritizedReplay2::updatePriority)
-      .def("keep_priority", &PrioritizedReplay2::keepPriority);
+      .def("keep_priority", &PrioritizedReplay2::keepPriority)
+      .def("sample_stats", &PrioritizedReplay2::sampleStats)
+      .def("save", &PrioritizedReplay2::save)
+      .def("load", &PrioritizedReplay2::load);
 
   py::class_<FFTransition, std::shared_ptr<FFTransition>>(m, "FFTransition")
       .def_readwrite("obs", &FFTransition::obs)
@@ -102,14 +113,41 @@ PYBIND11_MODULE(rela, m) {
       .def("spec", &Env::spec)
       .def("terminated", &Env::terminated);
 
+  py::enum_<Dispatch>(m, "Dispatch")
+      .value("LEAST_LOADED", Dispatch::LEAST_LOADED)
+      .value("ROUND_ROBIN", Dispatch::ROUND_ROBIN);
+
   py::class_<BatchProcessorUnit, std::shared_ptr<BatchProcessorUnit>>(
       m, "BatchProcessor")
       .def(py::init<std::shared_ptr<ModelLocker>, const std::string&, int,
-                    const std::string&>());
+                    const std::string&>())
+      .def(py::init<std::shared_ptr<ModelLocker>, const std::string&, int,
+                    const std::string&, int>())  // max batch wait in us
+      .def(py::init<std::shared_ptr<ModelLocker>, const std::string&, int,
+                    const std::string&, int,
+                    int>())  // max batch wait in us, #batch buffers
+      // one forward thread per model locker (replica / device)
+      .def(py::init<std::vector<std::shared_ptr<ModelLocker>>,
+                    const std::string&, int, Dispatch, int, int>())
+      .def(py::init<std::vector<std::shared_ptr<ModelLocker>>,
+                    const std::string&, int, Dispatch, int, int,
+                    Placement>())  // numa placement
+      .def("num_batchers", &BatchProcessorUnit::numBatchers);
+
+  py::class_<Placement>(m, "Placement")
+      .def(py::init<>())
+      .def_readwrite("numa_node", &Placement::numaNode)
+      .def_readwrite("batcher_per_node", &Placement::batcherPerNode);
+
+  m.def("topology_report", &topologyReport);
+
+  // counters and histograms of every thread, see rela/metrics.h
+  m.def("metrics_snapshot", &metrics::snapshot);
 
   py::class_<Models, std::shared_ptr<Models>>(m, "Models")
       .def(py::init<>())
-      .def("add", &Models::add, py::keep_alive<1, 2>());
+      .def("add", &Models::add, py::keep_alive<1, 2>())
+      .def("set_draining", &Models::setDraining);
 
   py::class_<ThreadLoop, std::shared_ptr<ThreadLoop>>(m, "ThreadLoop");
 
@@ -122,9 +160,13 @@ PYBIND11_MODULE(rela, m) {
 
   py::class_<Context>(m, "Context")
       .def(py::init<>())
+      .def(py::init<int, bool>(),
+           py::arg("num_threads"),     // 0: one thread per loop
+           py::arg("pin_threads") = true)
       .def("push_env_thread", &Context::pushThreadLoop, py::keep_alive<1, 2>())
       .def("start", &Context::start)
       .def("pause", &Context::pause)
+      .def("drain", &Context::drain)  // timeout in ms, returns all parked
       .def("resume", &Context::resume)
       .def("terminate", &Context::terminate)
       .def("terminated", &Context::terminated);
@@ -3,9 +3,14 @@
 #include "rela/actor.h"
 #include "rela/dqn_actor.h"
 #include <stdlib.h>
+#include <cmath>
 
 namespace rela {
 
+// Holds up to two episodes (seqLen * 2 steps) per env in flat
+// [batchsize * seqLen * 2, ...] tensors, allocated on the first push. A
+// push writes all envs with one index_copy_ per field; terminals and the
+// reward refill work on the raw arrays.
 class R2D2TransitionBuffer {
  public:
   R2D2TransitionBuffer(
@@ -14,13 +19,15 @@ class R2D2TransitionBuffer {
       , numPlayer(numPlayer)
       , multiStep(multiStep)
       , seqLen(seqLen)
+      , capacity_(seqLen * 2)
       , batchNextIdx_(batchsize, 0)
       , batchH0_(batchsize)
-      , batchSeqTransition_(batchsize, std::vector<FFTransition>(seqLen * 2))
       , batchSeqPriority_(batchsize, std::vector<float>(seqLen * 2))
       , batchLen_(batchsize, 0)
       , firstTerminals_(batchsize, 0)
       , terminalCount_(batchsize, 0)
+      , terminalFlags_(batchsize * seqLen * 2, 0)
+      , stepIdx_(torch::zeros({batchsize}, torch::kInt64))
       , canPop_(false) {
     assert(burnin == 0);
   }
@@ -29,80 +36,79 @@ class R2D2TransitionBuffer {
             const torch::Tensor& priority,
             const TensorDict& hid) {
     assert(priority.size(0) == batchsize);
+    if (!reward_.defined()) {
+      allocate(transition);
+    }
 
     auto priorityAccessor = priority.accessor<float, 1>();
+    auto terminal = transition.terminal.to(torch::kBool);
+    auto terminalAccessor = terminal.accessor<bool, 1>();
+    auto stepIdx = stepIdx_.accessor<int64_t, 1>();
 
     for (int i = 0; i < batchsize; ++i) {
       int nextIdx = batchNextIdx_[i];
-      assert(nextIdx < seqLen * 2 && nextIdx >= 0);
+      assert(nextIdx < capacity_ && nextIdx >= 0);
       if (nextIdx == 0) {
         batchH0_[i] = utils::tensorDictNarrow(
             hid, 1, i * numPlayer, numPlayer, false, true);
-        // for (auto& kv : batchH0_[i]) {
-        //   assert(kv.second.sum().item<float>() == 0);
-        // }
-      }
-
-      auto t = transition.index(i);
-      // some sanity check for termination
-      if (nextIdx != 0) {
+      } else {
         // should not append after terminal
         // terminal should be processed when it is pushed
-        assert(!batchSeqTransition_[i][nextIdx - 1].terminal.item<bool>() ||
+        assert(!terminalFlags_[i * capacity_ + nextIdx - 1] ||
                terminalCount_[i] == 1);
         assert(batchLen_[i] == 0);
       }
-
-      batchSeqTransition_[i][nextIdx] = t;
+      stepIdx[i] = (int64_t)i * capacity_ + nextIdx;
       batchSeqPriority_[i][nextIdx] = priorityAccessor[i];
-
+      terminalFlags_[i * capacity_ + nextIdx] = terminalAccessor[i];
       ++batchNextIdx_[i];
+    }
 
-      if (t.terminal.item<bool>()) {
-        terminalCount_[i] += 1;
-      }
+    // one scatter per field for the whole batch
+    for (auto& kv : obs_) {
+      kv.second.index_copy_(0, stepIdx_, transition.obs.at(kv.first));
+    }
+    for (auto& kv : action_) {
+      kv.second.index_copy_(0, stepIdx_, transition.action.at(kv.first));
+    }
+    reward_.index_copy_(0, stepIdx_, transition.reward);
+    terminal_.index_copy_(0, stepIdx_, transition.terminal);
+    bootstrap_.index_copy_(0, stepIdx_, transition.bootstrap);
 
+    auto reward = reward_.accessor<float, 1>();
+    for (int i = 0; i < batchsize; ++i) {
+      if (!terminalAccessor[i]) {
+        continue;
+      }
+      terminalCount_[i] += 1;
       if (terminalCount_[i] < 2) {
         continue;
       }
       terminalCount_[i] = 0;
-
-      // pad the rest of the seq in case of terminal
       batchLen_[i] = batchNextIdx_[i];
-      /*
-      while (batchNextIdx_[i] < seqLen) {
-        batchSeqTransition_[i][batchNextIdx_[i]] = t.padLike();
-        batchSeqPriority_[i][batchNextIdx_[i]] = 0;
-        ++batchNextIdx_[i];
-      }*/
 
       // refill reward
-
+      const int64_t base = (int64_t)i * capacity_;
+      auto& seqPriority = batchSeqPriority_[i];
       for (int j = 0; j < batchLen_[i] - 1; j++) {
-        if (batchSeqTransition_[i][j].terminal.item<bool>()) {
+        if (terminalFlags_[base + j]) {
           firstTerminals_[i] = j;
           assert(j <= seqLen);
           for (int m = 0; m < multiStep; m++) {
+            assert(j - m >= 0);
             // copy over multistep reward
-            auto r = batchSeqTransition_[i][batchLen_[i] - 1 - m].reward;
-            batchSeqTransition_[i][j - m].reward = r.clone();
+            float r = reward[base + batchLen_[i] - 1 - m];
+            reward[base + j - m] = r;
             // also fix priority target
-            batchSeqPriority_[i][j - m] =
-                batchSeqPriority_[i][j - m] + r.item<float>();
+            seqPriority[j - m] = seqPriority[j - m] + r;
           }
           break;
         }
       }
       // now abs
       for (int j = 0; j < batchLen_[i]; j++) {
-        batchSeqPriority_[i][j] = abs(batchSeqPriority_[i][j]);
+        seqPriority[j] = std::abs(seqPriority[j]);
       }
-      /*
-      std::cout << "*****" << std::endl;
-      for (int j = 0; j < batchLen_[i] - 1; j++) {
-        std::cout << batchSeqTransition_[i][j].reward.item<float>() << " ";
-      }
-      */
       canPop_ = true;
     }
   }
@@ -115,70 +121,44 @@ class R2D2TransitionBuffer {
   popTransition() {
     assert(canPop_);
 
+    int numSeq = 0;
+    for (int i = 0; i < batchsize; ++i) {
+      numSeq += batchLen_[i] == 0 ? 0 : 2;
+    }
+    assert(numSeq > 0);
+
     std::vector<RNNTransition> batchTransition;
-    std::vector<torch::Tensor> batchSeqPriority;
-    std::vector<float> batchLen;
+    batchTransition.reserve(numSeq);
+    auto batchSeqPriority = torch::zeros({numSeq, seqLen}, torch::kFloat32);
+    auto batchLen = torch::zeros({numSeq}, torch::kFloat32);
+    auto priority = batchSeqPriority.accessor<float, 2>();
+    auto len = batchLen.accessor<float, 1>();
 
     for (int i = 0; i < batchsize; ++i) {
       if (batchLen_[i] == 0) {
         continue;
       }
-      // assert(batchNextIdx_[i] == seqLen);
-
-      int len1 = firstTerminals_[i] + 1;
-      batchLen.push_back(float(len1));
-
-      std::vector<float> batchSeqPriority1(
-          batchSeqPriority_[i].begin(), batchSeqPriority_[i].begin() + len1);
-      while (batchSeqPriority1.size() < (size_t)seqLen) {
-        batchSeqPriority1.push_back(0);
-      }
-      batchSeqPriority.push_back(torch::tensor(batchSeqPriority1));
-
-      std::vector<FFTransition> batchSeqTransition1(
-          batchSeqTransition_[i].begin(),
-          batchSeqTransition_[i].begin() + len1);
-      while (batchSeqTransition1.size() < (size_t)seqLen) {
-        batchSeqTransition1.push_back(batchSeqTransition1[0].padLike());
-      }
-      auto t1 = RNNTransition(
-          batchSeqTransition1, batchH0_[i], torch::tensor(float(len1)));
-      batchTransition.push_back(t1);
-
-      // for (int tmp = 0; tmp < len1; tmp++)
-      //  t1.print(tmp);
-
-      int len2 = batchLen_[i] - len1;
-
-      batchLen.push_back(float(len2));
-      std::vector<float> batchSeqPriority2(
-          batchSeqPriority_[i].begin() + len1,
-          batchSeqPriority_[i].begin() + len1 + len2);
-      while (batchSeqPriority2.size() < (size_t)seqLen) {
-        batchSeqPriority2.push_back(0);
-      }
-      batchSeqPriority.push_back(torch::tensor(batchSeqPriority2));
-
-      std::vector<FFTransition> batchSeqTransition2(
-          batchSeqTransition_[i].begin() + len1,
-          batchSeqTransition_[i].begin() + len1 + len2);
-      while (batchSeqTransition2.size() < (size_t)seqLen) {
-        batchSeqTransition2.push_back(batchSeqTransition2[0].padLike());
+      // first episode ends at the first terminal, second one fills the rest
+      const int len1 = firstTerminals_[i] + 1;
+      const int len2 = batchLen_[i] - len1;
+      const int begins[2] = {0, len1};
+      const int lens[2] = {len1, len2};
+      for (int k = 0; k < 2; ++k) {
+        const int seq = batchTransition.size();
+        for (int j = 0; j < lens[k]; ++j) {
+          priority[seq][j] = batchSeqPriority_[i][begins[k] + j];
+        }
+        len[seq] = lens[k];
+        batchTransition.push_back(sequence(i, begins[k], lens[k]));
       }
 
-      auto t2 = RNNTransition(
-          batchSeqTransition2, batchH0_[i], torch::tensor(float(len2)));
-      batchTransition.push_back(t2);
-
       batchLen_[i] = 0;
       batchNextIdx_[i] = 0;
     }
     canPop_ = false;
-    assert(batchTransition.size() > 0);
 
-    return std::make_tuple(batchTransition,
-                           torch::stack(batchSeqPriority, 0),
-                           torch::tensor(batchLen));
+    return std::make_tuple(
+        std::move(batchTransition), batchSeqPriority, batchLen);
   }
 
   const int batchsize;
@@ -187,14 +167,77 @@ class R2D2TransitionBuffer {
   const int seqLen;
 
  private:
+  void allocate(const FFTransition& transition) {
+    const int64_t steps = (int64_t)batchsize * capacity_;
+    auto stepsLike = [steps](const torch::Tensor& t) {
+      auto sizes = t.sizes().vec();
+      sizes[0] = steps;
+      return torch::zeros(sizes, t.options());
+    };
+    for (const auto& kv : transition.obs) {
+      obs_.emplace(kv.first, stepsLike(kv.second));
+    }
+    for (const auto& kv : transition.action) {
+      action_.emplace(kv.first, stepsLike(kv.second));
+    }
+    reward_ = stepsLike(transition.reward);
+    terminal_ = stepsLike(transition.terminal);
+    bootstrap_ = stepsLike(transition.bootstrap);
+    assert(reward_.scalar_type() == torch::kFloat32);
+  }
+
+  // steps [begin, begin + len) of env i, padded to seqLen like
+  // FFTransition::padLike: zeros, terminal set
+  torch::Tensor padded(const torch::Tensor& steps,
+                       int i,
+                       int begin,
+                       int len,
+                       float pad) const {
+    assert(len > 0 && len <= seqLen);
+    auto sizes = steps.sizes().vec();
+    sizes[0] = seqLen;
+    auto seq = torch::full(sizes, pad, steps.options());
+    seq.narrow(0, 0, len)
+        .copy_(steps.narrow(0, (int64_t)i * capacity_ + begin, len));
+    return seq;
+  }
+
+  RNNTransition sequence(int i, int begin, int len) const {
+    RNNTransition t;
+    for (const auto& kv : obs_) {
+      t.obs.emplace(kv.first, padded(kv.second, i, begin, len, 0));
+    }
+    for (const auto& kv : action_) {
+      t.action.emplace(kv.first, padded(kv.second, i, begin, len, 0));
+    }
+    t.h0 = batchH0_[i];
+    t.reward = padded(reward_, i, begin, len, 0);
+    t.terminal = padded(terminal_, i, begin, len, 1);
+    t.bootstrap = padded(bootstrap_, i, begin, len, 0);
+    t.seqLen = torch::tensor(float(len));
+    return t;
+  }
+
+  const int capacity_;
+
   std::vector<int> batchNextIdx_;
   std::vector<TensorDict> batchH0_;
 
-  std::vector<std::vector<FFTransition>> batchSeqTransition_;
+  // [batchsize * capacity_, ...], step j of env i at i * capacity_ + j
+  TensorDict obs_;
+  TensorDict action_;
+  torch::Tensor reward_;
+  torch::Tensor terminal_;
+  torch::Tensor bootstrap_;
+
   std::vector<std::vector<float>> batchSeqPriority_;
   std::vector<int> batchLen_;
   std::vector<int> firstTerminals_;
   std::vector<int> terminalCount_;
+  // host copy of terminal_, read per step without touching tensors
+  std::vector<char> terminalFlags_;
+  // scatter index of the current push
+  torch::Tensor stepIdx_;
 
   bool canPop_;
 };
@@ -0,0 +1,244 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#include "rela/replay_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include "rela/logging.h"
+
+namespace rela {
+
+namespace {
+
+constexpr char kMagic[8] = {'R', 'E', 'L', 'A', 'R', 'P', 'L', 'Y'};
+constexpr int32_t kVersion = 1;
+constexpr int64_t kAlign = 4096;
+
+int64_t alignUp(int64_t offset) {
+  return (offset + kAlign - 1) / kAlign * kAlign;
+}
+
+int64_t tensorBytes(const torch::Tensor& t) {
+  return t.numel() * t.element_size();
+}
+
+template <typename T>
+void put(std::string& buf, T value) {
+  buf.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+class Reader {
+ public:
+  Reader(const char* data, int64_t size)
+      : data_(data)
+      , size_(size)
+      , pos_(0) {
+  }
+
+  template <typename T>
+  T get() {
+    T value;
+    read(&value, sizeof(T));
+    return value;
+  }
+
+  std::string getString(int len) {
+    std::string s(len, '\0');
+    read(&s[0], len);
+    return s;
+  }
+
+  void read(void* dst, int64_t len) {
+    RELA_CHECK(pos_ + len <= size_, "truncated replay snapshot");
+    std::memcpy(dst, data_ + pos_, len);
+    pos_ += len;
+  }
+
+ private:
+  const char* data_;
+  const int64_t size_;
+  int64_t pos_;
+};
+
+// header with block offsets. its size does not depend on the offsets, so
+// the writer serializes it twice, first to learn where the blocks start
+std::string encodeHeader(const ReplaySnapshot& snapshot,
+                         const std::vector<std::string>& names,
+                         const std::vector<int64_t>& offsets,
+                         int64_t leavesOffset) {
+  std::string buf(kMagic, sizeof(kMagic));
+  put<int32_t>(buf, kVersion);
+  put<int32_t>(buf, snapshot.numShards);
+  put<int32_t>(buf, snapshot.shardSlots);
+  put<int32_t>(buf, names.size());
+  put<int64_t>(buf, snapshot.numAdd);
+  for (int i = 0; i < snapshot.numShards; ++i) {
+    put<int32_t>(buf, snapshot.heads[i]);
+    put<int32_t>(buf, snapshot.tails[i]);
+    put<int32_t>(buf, snapshot.sizes[i]);
+  }
+  put<int64_t>(buf, leavesOffset);
+  for (size_t i = 0; i < names.size(); ++i) {
+    const auto& column = snapshot.columns.at(names[i]);
+    put<int32_t>(buf, names[i].size());
+    buf.append(names[i]);
+    put<int32_t>(buf, static_cast<int32_t>(column.scalar_type()));
+    put<int32_t>(buf, column.dim());
+    for (auto size : column.sizes()) {
+      put<int64_t>(buf, size);
+    }
+    put<int64_t>(buf, offsets[i]);
+  }
+  return buf;
+}
+
+// flush path's data (or a directory's entries) to disk
+void syncPath(const std::string& path, int flags) {
+  int fd = open(path.c_str(), flags);
+  RELA_CHECK(fd >= 0, "cannot open ", path, ": ", std::strerror(errno));
+  int ret = fsync(fd);
+  int err = errno;
+  close(fd);
+  RELA_CHECK(ret == 0, "cannot sync ", path, ": ", std::strerror(err));
+}
+
+void writeAt(std::ofstream& out, int64_t offset, const torch::Tensor& t) {
+  RELA_CHECK(t.device().is_cpu() && t.is_contiguous());
+  out.seekp(offset);
+  out.write(static_cast<const char*>(t.data_ptr()), tensorBytes(t));
+}
+
+}  // namespace
+
+void saveReplaySnapshot(const std::string& path,
+                        const ReplaySnapshot& snapshot) {
+  RELA_CHECK_EQ((int)snapshot.heads.size(), snapshot.numShards);
+  RELA_CHECK_EQ((int)snapshot.tails.size(), snapshot.numShards);
+  RELA_CHECK_EQ((int)snapshot.sizes.size(), snapshot.numShards);
+  RELA_CHECK_EQ(snapshot.leaves.numel(),
+                (int64_t)snapshot.numShards * snapshot.shardSlots);
+
+  std::vector<std::string> names;
+  for (const auto& kv : snapshot.columns) {
+    names.push_back(kv.first);
+  }
+  std::sort(names.begin(), names.end());
+
+  std::vector<int64_t> offsets(names.size(), 0);
+  int64_t offset =
+      alignUp(encodeHeader(snapshot, names, offsets, 0).size());
+  const int64_t leavesOffset = offset;
+  offset = alignUp(offset + tensorBytes(snapshot.leaves));
+  for (size_t i = 0; i < names.size(); ++i) {
+    offsets[i] = offset;
+    offset = alignUp(offset + tensorBytes(snapshot.columns.at(names[i])));
+  }
+  const std::string header =
+      encodeHeader(snapshot, names, offsets, leavesOffset);
+
+  // write aside, sync and rename, so that neither a crash nor a power loss
+  // leaves a torn snapshot behind
+  const std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    RELA_CHECK(out.good(), "cannot open ", tmpPath);
+    out.write(header.data(), header.size());
+    writeAt(out, leavesOffset, snapshot.leaves);
+    for (size_t i = 0; i < names.size(); ++i) {
+      writeAt(out, offsets[i], snapshot.columns.at(names[i]));
+    }
+    // pad the last block so every mapped block is whole pages
+    out.seekp(offset - 1);
+    out.put('\0');
+    out.close();
+    RELA_CHECK(out.good(), "failed writing ", tmpPath);
+  }
+  syncPath(tmpPath, O_WRONLY);
+  RELA_CHECK(std::rename(tmpPath.c_str(), path.c_str()) == 0,
+             "cannot rename ", tmpPath, ": ", std::strerror(errno));
+  // and the rename itself
+  const size_t slash = path.rfind('/');
+  syncPath(slash == std::string::npos ? "." : path.substr(0, slash + 1),
+           O_RDONLY | O_DIRECTORY);
+}
+
+ReplaySnapshot loadReplaySnapshot(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  RELA_CHECK(fd >= 0, "cannot open ", path, ": ", std::strerror(errno));
+  struct stat st;
+  RELA_CHECK(fstat(fd, &st) == 0, std::strerror(errno));
+  const int64_t fileSize = st.st_size;
+  void* addr = mmap(
+      nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  RELA_CHECK(addr != MAP_FAILED, "cannot map ", path, ": ",
+             std::strerror(errno));
+  // start paging in the background, sampling does not wait for it
+  madvise(addr, fileSize, MADV_WILLNEED);
+  std::shared_ptr<void> mapping(
+      addr, [fileSize](void* p) { munmap(p, fileSize); });
+
+  const char* base = static_cast<const char*>(addr);
+  auto fromFile = [&](int64_t offset,
+                      const std::vector<int64_t>& sizes,
+                      torch::ScalarType dtype) {
+    int64_t numel = 1;
+    for (auto size : sizes) {
+      numel *= size;
+    }
+    RELA_CHECK(offset % kAlign == 0 &&
+                   offset + numel * (int64_t)c10::elementSize(dtype) <= fileSize,
+               "corrupted replay snapshot ", path);
+    return torch::from_blob(const_cast<char*>(base) + offset,
+                            sizes,
+                            [mapping](void*) {},
+                            torch::TensorOptions().dtype(dtype));
+  };
+
+  Reader reader(base, fileSize);
+  RELA_CHECK(reader.getString(sizeof(kMagic)) ==
+                 std::string(kMagic, sizeof(kMagic)),
+             path, " is not a replay snapshot");
+  const int32_t version = reader.get<int32_t>();
+  RELA_CHECK_EQ(version, kVersion, "unsupported replay snapshot version");
+
+  ReplaySnapshot snapshot;
+  snapshot.numShards = reader.get<int32_t>();
+  snapshot.shardSlots = reader.get<int32_t>();
+  const int numFields = reader.get<int32_t>();
+  snapshot.numAdd = reader.get<int64_t>();
+  for (int i = 0; i < snapshot.numShards; ++i) {
+    snapshot.heads.push_back(reader.get<int32_t>());
+    snapshot.tails.push_back(reader.get<int32_t>());
+    snapshot.sizes.push_back(reader.get<int32_t>());
+  }
+  const int64_t leavesOffset = reader.get<int64_t>();
+  snapshot.leaves =
+      fromFile(leavesOffset,
+               {(int64_t)snapshot.numShards * snapshot.shardSlots},
+               torch::kFloat32);
+
+  for (int i = 0; i < numFields; ++i) {
+    auto name = reader.getString(reader.get<int32_t>());
+    auto dtype = static_cast<torch::ScalarType>(reader.get<int32_t>());
+    std::vector<int64_t> sizes(reader.get<int32_t>());
+    for (auto& size : sizes) {
+      size = reader.get<int64_t>();
+    }
+    snapshot.columns.emplace(name,
+                             fromFile(reader.get<int64_t>(), sizes, dtype));
+  }
+  return snapshot;
+}
+
+}  // namespace rela
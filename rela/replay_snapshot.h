@@ -0,0 +1,40 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "rela/types.h"
+
+namespace rela {
+
+// On-disk image of a PrioritizedReplay2: ring state per shard, the sampling
+// weight of every slot and the columnar element storage. Every block is
+// page aligned, so loading maps the file and wraps the blocks as tensors
+// without parsing or copying. Pages are faulted in on first touch, so the
+// replay can sample right after loading.
+struct ReplaySnapshot {
+  int numShards = 0;
+  int shardSlots = 0;
+  int64_t numAdd = 0;
+  // per shard, committed region only
+  std::vector<int> heads;
+  std::vector<int> tails;
+  std::vector<int> sizes;
+  // float [numShards * shardSlots]
+  torch::Tensor leaves;
+  // [numShards * shardSlots, ...] per field
+  TensorDict columns;
+};
+
+void saveReplaySnapshot(const std::string& path,
+                        const ReplaySnapshot& snapshot);
+
+// the returned tensors keep the mapping alive. the mapping is private, so
+// writes to them never reach the file
+ReplaySnapshot loadReplaySnapshot(const std::string& path);
+
+}  // namespace rela
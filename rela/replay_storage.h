@@ -0,0 +1,148 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "rela/logging.h"
+#include "rela/types.h"
+
+namespace rela {
+
+// Element store of PrioritizedReplayNew, addressed by slot. Different slots
+// may be written concurrently; gather() must not overlap with writes to the
+// slots it reads, which the replay guarantees through its sampler lock.
+template <class DataType>
+class ReplayStorage {
+ public:
+  ReplayStorage(int capacity)
+      : elements_(capacity) {
+  }
+
+  void write(int slot, const DataType& element) {
+    elements_[slot] = element;
+  }
+
+  // batch of the given slots, on cpu. pinMemory is not supported here
+  DataType gather(const std::vector<int>& slots,
+                  int batchdim,
+                  bool /* pinMemory */ = false) const {
+    std::vector<DataType> samples;
+    samples.reserve(slots.size());
+    for (int slot : slots) {
+      samples.push_back(elements_[slot]);
+    }
+    return DataType::makeBatch(samples, batchdim, "cpu");
+  }
+
+ private:
+  std::vector<DataType> elements_;
+};
+
+// Columnar layout for Transition: one [capacity, ...] tensor per field,
+// allocated from the first transition written. Writes copy a row in place
+// and gather is one index_select per field.
+template <>
+class ReplayStorage<Transition> {
+ public:
+  ReplayStorage(int capacity)
+      : capacity_(capacity) {
+  }
+
+  void write(int slot, const Transition& element) {
+    std::call_once(allocated_, [&] { allocate(element); });
+    RELA_CHECK_EQ(element.d.size(), columns_.size());
+    for (const auto& kv : element.d) {
+      auto it = columns_.find(kv.first);
+      RELA_CHECK(it != columns_.end(), "unknown field ", kv.first);
+      it->second[slot].copy_(kv.second);
+    }
+  }
+
+  // pinMemory gathers straight into page-locked memory, ready for a
+  // non_blocking upload
+  Transition gather(const std::vector<int>& slots,
+                    int batchdim,
+                    bool pinMemory = false) const {
+    std::vector<int64_t> index(slots.begin(), slots.end());
+    auto indexTensor = torch::tensor(index);
+
+    Transition batch;
+    batch.d.reserve(columns_.size());
+    for (const auto& kv : columns_) {
+      const auto& column = kv.second;
+      auto options = column.options().pinned_memory(pinMemory);
+      torch::Tensor rows;
+      if (batchdim == 0) {
+        std::vector<int64_t> sizes(column.sizes().begin(),
+                                   column.sizes().end());
+        sizes[0] = index.size();
+        rows = torch::empty(sizes, options);
+        torch::index_select_out(rows, column, 0, indexTensor);
+      } else {
+        // same layout as torch::stack(rows, batchdim)
+        auto selected = column.index_select(0, indexTensor)
+                            .permute(stackDims(column.dim(), batchdim));
+        rows = torch::empty(selected.sizes(), options);
+        rows.copy_(selected);
+      }
+      batch.d.emplace(kv.first, std::move(rows));
+    }
+    return batch;
+  }
+
+  // empty until the first write() or assign()
+  const TensorDict& columns() const {
+    return columns_;
+  }
+
+  // adopts columns, e.g. mapped from a snapshot, instead of allocating.
+  // must happen before the first write()
+  void assign(TensorDict columns) {
+    bool assigned = false;
+    std::call_once(allocated_, [&] {
+      columns_ = std::move(columns);
+      assigned = true;
+    });
+    RELA_CHECK(assigned, "replay storage is already allocated");
+    for (const auto& kv : columns_) {
+      RELA_CHECK_EQ(kv.second.size(0), capacity_, kv.first);
+    }
+  }
+
+ private:
+  // permutation moving dim 0 of a [n, ...] tensor to batchdim
+  static std::vector<int64_t> stackDims(int64_t dim, int batchdim) {
+    std::vector<int64_t> dims;
+    for (int64_t i = 1; i < dim; ++i) {
+      if (i - 1 == batchdim) {
+        dims.push_back(0);
+      }
+      dims.push_back(i);
+    }
+    if ((int64_t)dims.size() < dim) {
+      dims.push_back(0);
+    }
+    return dims;
+  }
+
+  void allocate(const Transition& element) {
+    for (const auto& kv : element.d) {
+      std::vector<int64_t> sizes = {capacity_};
+      sizes.insert(sizes.end(), kv.second.sizes().begin(),
+                   kv.second.sizes().end());
+      columns_.emplace(kv.first,
+                       torch::zeros(sizes, kv.second.options()));
+    }
+  }
+
+  const int64_t capacity_;
+  std::once_flag allocated_;
+  TensorDict columns_;
+};
+
+}  // namespace rela
@@ -0,0 +1,89 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace rela {
+
+// Binary sum tree over a fixed number of non-negative weights. Leaves sit at
+// [size_, 2 * size_), node i holds the sum of nodes 2i and 2i+1, so setting a
+// weight and finding the leaf under a prefix sum are both O(log N).
+// Not thread-safe, callers lock.
+class SumTree {
+ public:
+  explicit SumTree(int capacity)
+      : capacity_(capacity)
+      , size_(1) {
+    assert(capacity > 0);
+    while (size_ < capacity) {
+      size_ <<= 1;
+    }
+    nodes_.assign(2 * size_, 0);
+  }
+
+  int capacity() const {
+    return capacity_;
+  }
+
+  double total() const {
+    return nodes_[1];
+  }
+
+  double get(int idx) const {
+    assert(idx >= 0 && idx < capacity_);
+    return nodes_[size_ + idx];
+  }
+
+  void set(int idx, double weight) {
+    assert(idx >= 0 && idx < capacity_);
+    assert(weight >= 0);
+    int node = size_ + idx;
+    nodes_[node] = weight;
+    // recompute from children rather than adding deltas, so rounding errors
+    // do not accumulate over millions of updates.
+    for (node >>= 1; node >= 1; node >>= 1) {
+      nodes_[node] = nodes_[2 * node] + nodes_[2 * node + 1];
+    }
+  }
+
+  // Replaces all capacity() weights at once, O(N) instead of N set() calls.
+  void assign(const float* weights) {
+    for (int i = 0; i < capacity_; ++i) {
+      assert(weights[i] >= 0);
+      nodes_[size_ + i] = weights[i];
+    }
+    std::fill(nodes_.begin() + size_ + capacity_, nodes_.end(), 0);
+    for (int node = size_ - 1; node >= 1; --node) {
+      nodes_[node] = nodes_[2 * node] + nodes_[2 * node + 1];
+    }
+  }
+
+  // Index of the leaf where the running sum of weights first exceeds
+  // prefix. Never returns a zero weight leaf as long as total() > 0.
+  int find(double prefix) const {
+    assert(total() > 0);
+    prefix = std::max(0.0, prefix);
+    int node = 1;
+    while (node < size_) {
+      const double left = nodes_[2 * node];
+      const double right = nodes_[2 * node + 1];
+      if (prefix < left || right <= 0) {
+        node = 2 * node;
+      } else {
+        prefix -= left;
+        node = 2 * node + 1;
+      }
+    }
+    return node - size_;
+  }
+
+ private:
+  const int capacity_;
+  int size_;
+  std::vector<double> nodes_;
+};
+
+}  // namespace rela
@@ -0,0 +1,162 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <c10/util/SmallVector.h>
+#include <torch/torch.h>
+
+#include "rela/logging.h"
+#include "rela/types.h"
+
+namespace rela {
+
+// Fixed set of field names. Names are resolved to indices once, when hot
+// code sets up; after that records are accessed by index only.
+class RecordSchema {
+ public:
+  explicit RecordSchema(std::vector<std::string> names)
+      : names_(std::move(names)) {
+    for (int i = 0; i < (int)names_.size(); ++i) {
+      bool inserted = index_.emplace(names_[i], i).second;
+      RELA_CHECK(inserted, "duplicate field ", names_[i]);
+    }
+  }
+
+  // fields of dict in sorted order, plus extra ones that are filled later
+  static std::shared_ptr<const RecordSchema> fromTensorDict(
+      const TensorDict& dict, const std::vector<std::string>& extra = {}) {
+    std::vector<std::string> names;
+    names.reserve(dict.size() + extra.size());
+    for (const auto& kv : dict) {
+      names.push_back(kv.first);
+    }
+    std::sort(names.begin(), names.end());
+    for (const auto& name : extra) {
+      if (dict.find(name) == dict.end()) {
+        names.push_back(name);
+      }
+    }
+    return std::make_shared<const RecordSchema>(std::move(names));
+  }
+
+  int size() const {
+    return names_.size();
+  }
+
+  const std::string& name(int i) const {
+    return names_[i];
+  }
+
+  // -1 if absent
+  int fieldId(const std::string& name) const {
+    auto it = index_.find(name);
+    return it == index_.end() ? -1 : it->second;
+  }
+
+  // whether dict has exactly the fields of this schema
+  bool matches(const TensorDict& dict) const {
+    if ((int)dict.size() != size()) {
+      return false;
+    }
+    for (const auto& kv : dict) {
+      if (index_.find(kv.first) == index_.end()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, int> index_;
+};
+
+// TensorDict replacement for per-step code: one tensor per schema field,
+// stored inline for typical observation sizes. Copies share the tensors,
+// like copies of a TensorDict do.
+class TensorRecord {
+ public:
+  static constexpr int kInlineFields = 16;
+
+  TensorRecord() = default;
+
+  explicit TensorRecord(std::shared_ptr<const RecordSchema> schema)
+      : schema_(std::move(schema))
+      , fields_(schema_->size()) {
+  }
+
+  // fields of dict missing from the schema are an error, schema fields
+  // missing from dict are left undefined
+  static TensorRecord fromTensorDict(std::shared_ptr<const RecordSchema> schema,
+                                     const TensorDict& dict) {
+    TensorRecord record(std::move(schema));
+    for (const auto& kv : dict) {
+      int i = record.schema_->fieldId(kv.first);
+      RELA_CHECK(i >= 0, "field ", kv.first, " is not in the schema");
+      record.fields_[i] = kv.second;
+    }
+    return record;
+  }
+
+  // One pass over dict for per-step code: false, with *record left in an
+  // unspecified state, unless dict has exactly the fields of schema.
+  static bool tryFromTensorDict(std::shared_ptr<const RecordSchema> schema,
+                                const TensorDict& dict, TensorRecord* record) {
+    if ((int)dict.size() != schema->size()) {
+      return false;
+    }
+    *record = TensorRecord(std::move(schema));
+    for (const auto& kv : dict) {
+      int i = record->schema_->fieldId(kv.first);
+      if (i < 0) {
+        return false;
+      }
+      record->fields_[i] = kv.second;
+    }
+    return true;
+  }
+
+  // undefined fields are skipped
+  TensorDict toTensorDict() const {
+    TensorDict dict;
+    dict.reserve(fields_.size());
+    for (int i = 0; i < (int)fields_.size(); ++i) {
+      if (fields_[i].defined()) {
+        dict.emplace(schema_->name(i), fields_[i]);
+      }
+    }
+    return dict;
+  }
+
+  const RecordSchema& schema() const {
+    return *schema_;
+  }
+
+  const std::shared_ptr<const RecordSchema>& schemaPtr() const {
+    return schema_;
+  }
+
+  int size() const {
+    return fields_.size();
+  }
+
+  torch::Tensor& operator[](int i) {
+    return fields_[i];
+  }
+
+  const torch::Tensor& operator[](int i) const {
+    return fields_[i];
+  }
+
+ private:
+  std::shared_ptr<const RecordSchema> schema_;
+  c10::SmallVector<torch::Tensor, kInlineFields> fields_;
+};
+
+}  // namespace rela
@@ -3,9 +3,13 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 
 #include "rela/actor.h"
 #include "rela/env.h"
+#include "rela/wait_policy.h"
 
 namespace rela {
 
@@ -21,24 +25,38 @@ class ThreadLoop {
 
   virtual void terminate() {
     terminated_ = true;
+    // a paused loop has to wake up to see it
+    resumed_.notifyAll();
   }
 
   virtual void pause() {
-    std::lock_guard<std::mutex> lk(mPaused_);
     paused_ = true;
   }
 
   virtual void resume() {
-    {
-      std::lock_guard<std::mutex> lk(mPaused_);
-      paused_ = false;
-    }
-    cvPaused_.notify_one();
+    paused_ = false;
+    resumed_.notifyAll();
   }
 
+  // Called by mainLoop() where it holds no outstanding futures, which
+  // acknowledges the pause. Waits through WaitPolicy, so a paused loop
+  // running on a fiber frees its thread.
   virtual void waitUntilResume() {
-    std::unique_lock<std::mutex> lk(mPaused_);
-    cvPaused_.wait(lk, [this] { return !paused_; });
+    setParked(true);
+    resumed_.wait([this] { return !paused_.load() || terminated_.load(); });
+    setParked(false);
+  }
+
+  // after pause(): true once the loop is parked in waitUntilResume() or
+  // has returned, false if that did not happen by deadline
+  bool waitUntilParked(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lk(mParked_);
+    return cvParked_.wait_until(lk, deadline, [this] { return parked_; });
+  }
+
+  // called once mainLoop() has returned
+  void markDone() {
+    setParked(true);
   }
 
   virtual bool terminated() {
@@ -54,9 +72,20 @@ class ThreadLoop {
  private:
   std::atomic_bool terminated_{false};
 
-  std::mutex mPaused_;
-  bool paused_ = false;
-  std::condition_variable cvPaused_;
+  std::atomic_bool paused_{false};
+  WaitPolicy resumed_;
+
+  void setParked(bool parked) {
+    {
+      std::lock_guard<std::mutex> lk(mParked_);
+      parked_ = parked;
+    }
+    cvParked_.notify_all();
+  }
+
+  std::mutex mParked_;
+  std::condition_variable cvParked_;
+  bool parked_ = false;
 };
 
 // a simple implementation of ThreadLoop for single agent env
@@ -3,8 +3,8 @@
 // #include "rela/search_actor_refactored.h"
 // #include "rela/search_actor.h"
 #include "rela/thread_loop.h"
-#include "rela/clock.h"
 #include "rela/env_actor_base.h"
+#include "rela/metrics.h"
 
 // thread loop for joint Q learning
 // TODO: rename properly, change vector to shared_ptr
@@ -24,66 +24,76 @@ class ThreadLoopEnvActor : public rela::ThreadLoop {
   }
 
   void mainLoop() final {
-    auto& clock = rela::clock::gClocks.getClock();
-    clock.setName(std::to_string(threadIdx_));
-    clock.reset();
+    auto& m = LoopMetrics::get();
 
     while (!terminated()) {
-      if (paused()) {
-        waitUntilResume();
+      parkIfPaused();
+      if (terminated()) {
+        break;
       }
 
-      START_TIMING2(clock, "preAct")
-      // std::cout << "Before preAct" << std::endl;
-      for (auto& ea : envActors_) {
-        if (!isEnvFinished(*ea)) {
-          ea->preAct();
+      {
+        rela::metrics::ScopedTimer timer(m.preAct);
+        int numActive = 0;
+        for (auto& ea : envActors_) {
+          if (!isEnvFinished(*ea)) {
+            ea->preAct();
+            ++numActive;
+          }
         }
+        m.steps.add(numActive);
       }
-      END_TIMING
 
-      START_TIMING2(clock, "preActExecute")
-      executor_->execute();
-      END_TIMING
-
-      START_TIMING2(clock, "postAct")
-      // std::cout << "Before postAct" << std::endl;
-      for (auto& ea : envActors_) {
-        if (!isEnvFinished(*ea)) {
-          ea->postAct();
+      {
+        rela::metrics::ScopedTimer timer(m.preActExecute);
+        executor_->execute();
+      }
+      // no park point here: the act requests sent by preAct are still in the
+      // batchers and only consumed by postAct
+
+      {
+        rela::metrics::ScopedTimer timer(m.postAct);
+        for (auto& ea : envActors_) {
+          if (!isEnvFinished(*ea)) {
+            ea->postAct();
+          }
         }
       }
-      END_TIMING
-
-      START_TIMING2(clock, "postActExecute")
-      executor_->execute();
-      END_TIMING
 
-      // std::cout << "Before sendExperience" << std::endl;
-      START_TIMING2(clock, "sendExperience")
-      for (auto& ea : envActors_) {
-        if (!isEnvFinished(*ea)) {
-          ea->sendExperience();
+      {
+        rela::metrics::ScopedTimer timer(m.postActExecute);
+        executor_->execute();
+      }
+      parkIfPaused();
+
+      {
+        rela::metrics::ScopedTimer timer(m.sendExperience);
+        for (auto& ea : envActors_) {
+          if (!isEnvFinished(*ea)) {
+            ea->sendExperience();
+          }
         }
       }
-      END_TIMING
-
-      START_TIMING2(clock, "sendExperienceExecute")
-      executor_->execute();
-      END_TIMING
 
-      // std::cout << "Before postSendExperience" << std::endl;
-      START_TIMING2(clock, "postSendExperience")
-      for (auto& ea : envActors_) {
-        if (!isEnvFinished(*ea)) {
-          ea->postSendExperience();
+      {
+        rela::metrics::ScopedTimer timer(m.sendExperienceExecute);
+        executor_->execute();
+      }
+      parkIfPaused();
+
+      {
+        rela::metrics::ScopedTimer timer(m.postSendExperience);
+        for (auto& ea : envActors_) {
+          if (!isEnvFinished(*ea)) {
+            ea->postSendExperience();
+          }
         }
       }
-      END_TIMING
 
-      START_TIMING2(clock, "postSendExperienceExecute")
-      executor_->execute();
-      END_TIMING
+      {
+        rela::metrics::ScopedTimer timer(m.postSendExperienceExecute);
+        executor_->execute();
+      }
 
       bool allFinished = true;
       for (auto& ea : envActors_) {
@@ -93,19 +103,15 @@ class ThreadLoopEnvActor : public rela::ThreadLoop {
         }
       }
 
-      START_TIMING2(clock, "finalExecute")
-      executor_->execute();
-      END_TIMING
+      {
+        rela::metrics::ScopedTimer timer(m.finalExecute);
+        executor_->execute();
+      }
 
       if (allFinished) {
         // std::cout << "all Finished! Existing mainloop!" << std::endl;
         break;
       }
-
-      loopCnt_ ++;
-      if (loopCnt_ % 100 == 0 && threadIdx_ == 0) {
-        PRINT_TIMING_SUMMARY2(clock);
-      }
     }
   }
 
@@ -116,7 +122,38 @@ class ThreadLoopEnvActor : public rela::ThreadLoop {
   std::shared_ptr<rela::FutureExecutor> executor_;
   const int numGamePerEnv_;
 
-  int loopCnt_ = 0;
+  // shared by all loops, see rela::metrics::snapshot()
+  struct LoopMetrics {
+    static LoopMetrics& get() {
+      static LoopMetrics m;
+      return m;
+    }
+
+    // env actors stepped, divide by time_s for steps/sec
+    const rela::metrics::Counter steps{"env.steps"};
+    const rela::metrics::Histogram preAct{"env_loop.preAct_us"};
+    const rela::metrics::Histogram preActExecute{"env_loop.preActExecute_us"};
+    const rela::metrics::Histogram postAct{"env_loop.postAct_us"};
+    const rela::metrics::Histogram postActExecute{"env_loop.postActExecute_us"};
+    const rela::metrics::Histogram sendExperience{"env_loop.sendExperience_us"};
+    const rela::metrics::Histogram sendExperienceExecute{
+        "env_loop.sendExperienceExecute_us"};
+    const rela::metrics::Histogram postSendExperience{
+        "env_loop.postSendExperience_us"};
+    const rela::metrics::Histogram postSendExperienceExecute{
+        "env_loop.postSendExperienceExecute_us"};
+    const rela::metrics::Histogram finalExecute{"env_loop.finalExecute_us"};
+  };
+
+  // Called only where nothing of this loop is in flight: after postAct has
+  // consumed the act replies and the executor has run every pending future.
+  // A pause is acknowledged there rather than only at the top of the next
+  // iteration.
+  void parkIfPaused() {
+    if (paused()) {
+      waitUntilResume();
+    }
+  }
 
   bool isEnvFinished(const EnvActorBase& ea) const {
     return (numGamePerEnv_ > 0 && ea.getTerminalCount() >= numGamePerEnv_) || ea.isTerminated();
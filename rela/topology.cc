@@ -0,0 +1,218 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#include "rela/topology.h"
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+namespace rela {
+
+namespace {
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+std::vector<int> parseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty() || range == "\n") {
+      continue;
+    }
+    auto dash = range.find('-');
+    int first = std::stoi(range.substr(0, dash));
+    int last = dash == std::string::npos ? first
+                                         : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::string formatCpus(const std::vector<int>& cpus) {
+  std::stringstream ss;
+  for (size_t i = 0; i < cpus.size();) {
+    size_t j = i;
+    while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+      ++j;
+    }
+    ss << (i == 0 ? "" : ",") << cpus[i];
+    if (j > i) {
+      ss << "-" << cpus[j];
+    }
+    i = j + 1;
+  }
+  return ss.str();
+}
+
+// first line of a sysfs file, empty if it can't be read
+std::string readLine(const std::string& path) {
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+// online cpus in the affinity mask of the process
+std::vector<bool> usableCpus() {
+  std::vector<bool> usable;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    return usable;
+  }
+  usable.resize(CPU_SETSIZE, false);
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    usable[cpu] = CPU_ISSET(cpu, &set);
+  }
+  const std::string online = readLine("/sys/devices/system/cpu/online");
+  if (!online.empty()) {
+    std::vector<bool> isOnline(CPU_SETSIZE, false);
+    for (int cpu : parseCpuList(online)) {
+      if (cpu < CPU_SETSIZE) {
+        isOnline[cpu] = true;
+      }
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      usable[cpu] = usable[cpu] && isOnline[cpu];
+    }
+  }
+  return usable;
+}
+
+std::mutex mPlacements;
+std::vector<std::pair<std::string, std::string>> placements;
+
+}  // namespace
+
+Topology::Topology() {
+  const std::vector<bool> usable = usableCpus();
+  auto isUsable = [&usable](int cpu) {
+    // without an affinity mask every cpu is taken as usable
+    return usable.empty() || (cpu < (int)usable.size() && usable[cpu]);
+  };
+
+  // node ids may have gaps, the online list has the ones that exist
+  const std::string online = readLine("/sys/devices/system/node/online");
+  for (int node : parseCpuList(online)) {
+    std::vector<int> cpus;
+    for (int cpu : parseCpuList(readLine("/sys/devices/system/node/node" +
+                                         std::to_string(node) + "/cpulist"))) {
+      if (isUsable(cpu)) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (!cpus.empty()) {
+      nodeCpus_.push_back(std::move(cpus));
+      kernelNodes_.push_back(node);
+    }
+  }
+  if (nodeCpus_.empty()) {
+    const int numCpus = usable.empty()
+                            ? std::max(1u, std::thread::hardware_concurrency())
+                            : (int)usable.size();
+    nodeCpus_.emplace_back();
+    kernelNodes_.push_back(0);
+    for (int cpu = 0; cpu < numCpus; ++cpu) {
+      if (isUsable(cpu)) {
+        nodeCpus_[0].push_back(cpu);
+      }
+    }
+  }
+
+  for (int node = 0; node < numNodes(); ++node) {
+    for (int cpu : nodeCpus_[node]) {
+      cpus_.push_back(cpu);
+      if (cpu >= (int)cpuNode_.size()) {
+        cpuNode_.resize(cpu + 1, -1);
+      }
+      cpuNode_[cpu] = node;
+    }
+  }
+}
+
+const Topology& Topology::get() {
+  static const Topology topology;
+  return topology;
+}
+
+int Topology::currentNode() const {
+  return nodeOfCpu(sched_getcpu());
+}
+
+bool pinThreadToCpus(std::thread& thread, const std::vector<int>& cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &set);
+  }
+  return !cpus.empty() &&
+         pthread_setaffinity_np(
+             thread.native_handle(), sizeof(set), &set) == 0;
+}
+
+bool bindMemoryToNode(void* data, size_t bytes, int node) {
+  const auto& topology = Topology::get();
+  if (node < 0 || node >= topology.numNodes()) {
+    return false;
+  }
+  node = topology.kernelNode(node);
+  if (node >= (int)(8 * sizeof(unsigned long))) {
+    return false;
+  }
+  // mbind works on whole pages; leave partial ones at the edges alone since
+  // they may belong to other allocations
+  const uintptr_t page = sysconf(_SC_PAGESIZE);
+  const uintptr_t addr = reinterpret_cast<uintptr_t>(data);
+  const uintptr_t begin = (addr + page - 1) / page * page;
+  const uintptr_t end = (addr + bytes) / page * page;
+  if (end <= begin) {
+    return true;
+  }
+  unsigned long mask = 1UL << node;
+  long ret = syscall(SYS_mbind,
+                     reinterpret_cast<void*>(begin),
+                     end - begin,
+                     MPOL_BIND,
+                     &mask,
+                     8 * sizeof(mask),
+                     MPOL_MF_MOVE);
+  return ret == 0;
+}
+
+void recordPlacement(const std::string& what, const std::string& where) {
+  std::lock_guard<std::mutex> lk(mPlacements);
+  placements.emplace_back(what, where);
+}
+
+std::string topologyReport() {
+  const auto& topology = Topology::get();
+  std::stringstream ss;
+  ss << "topology: " << topology.numNodes() << " numa node(s), "
+     << topology.cpus().size() << " cpu(s)" << std::endl;
+  for (int node = 0; node < topology.numNodes(); ++node) {
+    ss << "  node " << node;
+    if (topology.kernelNode(node) != node) {
+      ss << " (node" << topology.kernelNode(node) << ")";
+    }
+    ss << ": cpus " << formatCpus(topology.nodeCpus(node)) << std::endl;
+  }
+  std::lock_guard<std::mutex> lk(mPlacements);
+  for (const auto& p : placements) {
+    ss << "  " << p.first << " -> " << p.second << std::endl;
+  }
+  return ss.str();
+}
+
+}  // namespace rela
@@ -0,0 +1,77 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rela {
+
+// NUMA nodes and their cpus as listed in /sys/devices/system/node, limited
+// to the online cpus this process may run on (its affinity mask, e.g. a
+// cpuset). Nodes left without cpus, memory only ones included, are skipped,
+// so nodes are numbered 0..numNodes() - 1 whatever the kernel calls them.
+// Hosts without that information show up as a single node holding every
+// usable cpu.
+class Topology {
+ public:
+  static const Topology& get();
+
+  int numNodes() const {
+    return (int)nodeCpus_.size();
+  }
+
+  const std::vector<int>& nodeCpus(int node) const {
+    return nodeCpus_.at(node);
+  }
+
+  // the kernel's number for node, as used by mbind
+  int kernelNode(int node) const {
+    return kernelNodes_.at(node);
+  }
+
+  // every cpu, grouped by node
+  const std::vector<int>& cpus() const {
+    return cpus_;
+  }
+
+  // -1 for cpus not listed under any node
+  int nodeOfCpu(int cpu) const {
+    return cpu >= 0 && cpu < (int)cpuNode_.size() ? cpuNode_[cpu] : -1;
+  }
+
+  // node of the cpu the calling thread is running on right now
+  int currentNode() const;
+
+ private:
+  Topology();
+
+  std::vector<std::vector<int>> nodeCpus_;
+  std::vector<int> kernelNodes_;
+  std::vector<int> cpus_;
+  std::vector<int> cpuNode_;
+};
+
+// pin thread; false if the kernel refused. Pinning from the thread that
+// started it means the placement is known, and recorded, once this returns.
+bool pinThreadToCpus(std::thread& thread, const std::vector<int>& cpus);
+
+inline bool pinThreadToNode(std::thread& thread, int node) {
+  return pinThreadToCpus(thread, Topology::get().nodeCpus(node));
+}
+
+// move the whole pages of [data, data + bytes) to node, numbered as in
+// Topology, and keep them there.
+// best effort: false if the kernel refused, e.g. without NUMA support
+bool bindMemoryToNode(void* data, size_t bytes, int node);
+
+// what was placed where, shown by topologyReport(); callers record a thread
+// only once pinning it has succeeded
+void recordPlacement(const std::string& what, const std::string& where);
+
+// nodes and their cpus followed by the recorded placements
+std::string topologyReport();
+
+}  // namespace rela
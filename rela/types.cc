@@ -5,31 +5,35 @@
 
 using namespace rela;
 
+namespace {
+
+// i -> transitions[i].*member, the accessor utils::tensorStack and
+// utils::tensorDictStack take
+template <typename T, typename Field>
+auto fieldOf(const std::vector<T>& transitions, Field T::*member) {
+  return [&transitions, member](int64_t i) -> const Field& {
+    return transitions[i].*member;
+  };
+}
+
+}  // namespace
+
 Transition Transition::makeBatch(std::vector<Transition> transitions, 
                                  int batchdim, 
                                  const std::string& device) {
   assert(transitions.size() >= 1);
 
-  TensorVecDict ds;
-
-  // std::cout << "#transitions: " << transitions.size() << std::endl;
-  // int num_empty = 0;
-
-  for (size_t i = 0; i < transitions.size(); i++) {
-    // if (i == 0) utils::tensorDictPrint(transitions[i].d);
-    // if (transitions[i].empty()) num_empty ++;
-    utils::tensorVecDictAppend(ds, transitions[i].d);
-  }
-
+  // stack straight into pinned memory, then one non_blocking upload
+  const bool upload = device != "cpu";
   Transition batch;
-  batch.d = utils::tensorDictJoin(ds, batchdim);
-  // std::cout << "num_empty: " << num_empty << ", Combined size:";
-  // utils::tensorDictPrint(batch.d);
-
-  if (device != "cpu") {
-    auto d = torch::Device(device);
-    auto toDevice = [&](const torch::Tensor& t) { return t.to(d); };
-    batch.d = utils::tensorDictApply(batch.d, toDevice);
+  batch.d = utils::tensorDictStack(
+      transitions.size(),
+      fieldOf(transitions, &Transition::d),
+      batchdim,
+      upload);
+
+  if (upload) {
+    return batch.toDevice(device, true);
   }
   return batch;
 }
@@ -51,6 +55,17 @@ Transition Transition::padLike() const {
   return pad;
 }
 
+Transition Transition::toDevice(const std::string& device,
+                                bool nonBlocking) const {
+  auto target = torch::Device(device);
+  auto toTarget = [&](const torch::Tensor& t) {
+    return t.to(target, nonBlocking);
+  };
+  Transition moved;
+  moved.d = utils::tensorDictApply(d, toTarget);
+  return moved;
+}
+
 TorchJitInput Transition::toJitInput(const torch::Device& device) const {
   TorchJitInput input;
   input.push_back(utils::tensorDictToTorchDict(d, device));
@@ -59,38 +74,31 @@ TorchJitInput Transition::toJitInput(const torch::Device& device) const {
 
 FFTransition FFTransition::makeBatch(
     const std::vector<FFTransition>& transitions, const std::string& device) {
-  TensorVecDict obsVec;
-  TensorVecDict actionVec;
-  std::vector<torch::Tensor> rewardVec;
-  std::vector<torch::Tensor> terminalVec;
-  std::vector<torch::Tensor> bootstrapVec;
-  TensorVecDict nextObsVec;
-
-  for (size_t i = 0; i < transitions.size(); i++) {
-    utils::tensorVecDictAppend(obsVec, transitions[i].obs);
-    utils::tensorVecDictAppend(actionVec, transitions[i].action);
-    rewardVec.push_back(transitions[i].reward);
-    terminalVec.push_back(transitions[i].terminal);
-    bootstrapVec.push_back(transitions[i].bootstrap);
-    utils::tensorVecDictAppend(nextObsVec, transitions[i].nextObs);
-  }
+  const int64_t n = transitions.size();
+  const bool upload = device != "cpu";
 
   FFTransition batch;
-  batch.obs = utils::tensorDictJoin(obsVec, 0);
-  batch.action = utils::tensorDictJoin(actionVec, 0);
-  batch.reward = torch::stack(rewardVec, 0);
-  batch.terminal = torch::stack(terminalVec, 0);
-  batch.bootstrap = torch::stack(bootstrapVec, 0);
-  batch.nextObs = utils::tensorDictJoin(nextObsVec, 0);
-
-  if (device != "cpu") {
+  batch.obs = utils::tensorDictStack(
+      n, fieldOf(transitions, &FFTransition::obs), 0, upload);
+  batch.action = utils::tensorDictStack(
+      n, fieldOf(transitions, &FFTransition::action), 0, upload);
+  batch.reward = utils::tensorStack(
+      n, fieldOf(transitions, &FFTransition::reward), 0, upload);
+  batch.terminal = utils::tensorStack(
+      n, fieldOf(transitions, &FFTransition::terminal), 0, upload);
+  batch.bootstrap = utils::tensorStack(
+      n, fieldOf(transitions, &FFTransition::bootstrap), 0, upload);
+  batch.nextObs = utils::tensorDictStack(
+      n, fieldOf(transitions, &FFTransition::nextObs), 0, upload);
+
+  if (upload) {
     auto d = torch::Device(device);
-    auto toDevice = [&](const torch::Tensor& t) { return t.to(d); };
+    auto toDevice = [&](const torch::Tensor& t) { return t.to(d, true); };
     batch.obs = utils::tensorDictApply(batch.obs, toDevice);
     batch.action = utils::tensorDictApply(batch.action, toDevice);
-    batch.reward = batch.reward.to(d);
-    batch.terminal = batch.terminal.to(d);
-    batch.bootstrap = batch.bootstrap.to(d);
+    batch.reward = toDevice(batch.reward);
+    batch.terminal = toDevice(batch.terminal);
+    batch.bootstrap = toDevice(batch.bootstrap);
     batch.nextObs = utils::tensorDictApply(batch.nextObs, toDevice);
   }
 
@@ -147,25 +155,17 @@ RNNTransition::RNNTransition(const std::vector<FFTransition>& transitions,
                              torch::Tensor seqLen)
     : h0(h0)
     , seqLen(seqLen) {
-  TensorVecDict obsVec;
-  TensorVecDict actionVec;
-  std::vector<torch::Tensor> rewardVec;
-  std::vector<torch::Tensor> terminalVec;
-  std::vector<torch::Tensor> bootstrapVec;
-
-  for (size_t i = 0; i < transitions.size(); i++) {
-    utils::tensorVecDictAppend(obsVec, transitions[i].obs);
-    utils::tensorVecDictAppend(actionVec, transitions[i].action);
-    rewardVec.push_back(transitions[i].reward);
-    terminalVec.push_back(transitions[i].terminal);
-    bootstrapVec.push_back(transitions[i].bootstrap);
-  }
-
-  obs = utils::tensorDictJoin(obsVec, 0);
-  action = utils::tensorDictJoin(actionVec, 0);
-  reward = torch::stack(rewardVec, 0);
-  terminal = torch::stack(terminalVec, 0);
-  bootstrap = torch::stack(bootstrapVec, 0);
+  const int64_t n = transitions.size();
+  obs = utils::tensorDictStack(
+      n, fieldOf(transitions, &FFTransition::obs), 0);
+  action = utils::tensorDictStack(
+      n, fieldOf(transitions, &FFTransition::action), 0);
+  reward = utils::tensorStack(
+      n, fieldOf(transitions, &FFTransition::reward), 0);
+  terminal = utils::tensorStack(
+      n, fieldOf(transitions, &FFTransition::terminal), 0);
+  bootstrap = utils::tensorStack(
+      n, fieldOf(transitions, &FFTransition::bootstrap), 0);
 }
 
 RNNTransition RNNTransition::index(int i) const {
@@ -191,43 +191,36 @@ RNNTransition RNNTransition::index(int i) const {
 
 RNNTransition RNNTransition::makeBatch(
     const std::vector<RNNTransition>& transitions, const std::string& device) {
-  TensorVecDict obsVec;
-  TensorVecDict h0Vec;
-  TensorVecDict actionVec;
-  std::vector<torch::Tensor> rewardVec;
-  std::vector<torch::Tensor> terminalVec;
-  std::vector<torch::Tensor> bootstrapVec;
-  std::vector<torch::Tensor> seqLenVec;
-
-  for (size_t i = 0; i < transitions.size(); i++) {
-    utils::tensorVecDictAppend(obsVec, transitions[i].obs);
-    utils::tensorVecDictAppend(h0Vec, transitions[i].h0);
-    utils::tensorVecDictAppend(actionVec, transitions[i].action);
-    rewardVec.push_back(transitions[i].reward);
-    terminalVec.push_back(transitions[i].terminal);
-    bootstrapVec.push_back(transitions[i].bootstrap);
-    seqLenVec.push_back(transitions[i].seqLen);
-  }
+  const int64_t n = transitions.size();
+  const bool upload = device != "cpu";
 
   RNNTransition batch;
-  batch.obs = utils::tensorDictJoin(obsVec, 1);
-  batch.h0 = utils::tensorDictJoin(h0Vec, 1);  // 1 is batch for rnn hid
-  batch.action = utils::tensorDictJoin(actionVec, 1);
-  batch.reward = torch::stack(rewardVec, 1);
-  batch.terminal = torch::stack(terminalVec, 1);
-  batch.bootstrap = torch::stack(bootstrapVec, 1);
-  batch.seqLen = torch::stack(seqLenVec, 0).squeeze(1);
-
-  if (device != "cpu") {
+  batch.obs = utils::tensorDictStack(
+      n, fieldOf(transitions, &RNNTransition::obs), 1, upload);
+  // 1 is batch for rnn hid
+  batch.h0 = utils::tensorDictStack(
+      n, fieldOf(transitions, &RNNTransition::h0), 1, upload);
+  batch.action = utils::tensorDictStack(
+      n, fieldOf(transitions, &RNNTransition::action), 1, upload);
+  batch.reward = utils::tensorStack(
+      n, fieldOf(transitions, &RNNTransition::reward), 1, upload);
+  batch.terminal = utils::tensorStack(
+      n, fieldOf(transitions, &RNNTransition::terminal), 1, upload);
+  batch.bootstrap = utils::tensorStack(
+      n, fieldOf(transitions, &RNNTransition::bootstrap), 1, upload);
+  batch.seqLen = utils::tensorStack(
+      n, fieldOf(transitions, &RNNTransition::seqLen), 0, upload).squeeze(1);
+
+  if (upload) {
     auto d = torch::Device(device);
-    auto toDevice = [&](const torch::Tensor& t) { return t.to(d); };
+    auto toDevice = [&](const torch::Tensor& t) { return t.to(d, true); };
     batch.obs = utils::tensorDictApply(batch.obs, toDevice);
     batch.h0 = utils::tensorDictApply(batch.h0, toDevice);
     batch.action = utils::tensorDictApply(batch.action, toDevice);
-    batch.reward = batch.reward.to(d);
-    batch.terminal = batch.terminal.to(d);
-    batch.bootstrap = batch.bootstrap.to(d);
-    batch.seqLen = batch.seqLen.to(d);
+    batch.reward = toDevice(batch.reward);
+    batch.terminal = toDevice(batch.terminal);
+    batch.bootstrap = toDevice(batch.bootstrap);
+    batch.seqLen = toDevice(batch.seqLen);
   }
 
   return batch;
@@ -31,6 +31,9 @@ class Transition {
 
   Transition padLike() const;
 
+  Transition toDevice(const std::string& device,
+                      bool nonBlocking = false) const;
+
   TorchJitInput toJitInput(const torch::Device& device) const;
 
   bool empty() const {
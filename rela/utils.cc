@@ -49,6 +49,35 @@ bool tensorDictEq(const TensorDict& a, const TensorDict& b) {
   return true;
 }
 
+TensorDict iValueToTensorDict(const torch::IValue& value, TensorDict& staging) {
+  TensorDict map;
+  auto dict = value.toGenericDict();
+  map.reserve(dict.size());
+  for (auto& name2tensor : dict) {
+    const auto& name = name2tensor.key().toStringRef();
+    torch::Tensor tensor = name2tensor.value().toTensor().detach();
+    if (tensor.device().is_cpu()) {
+      map.emplace(name, std::move(tensor));
+      continue;
+    }
+
+    auto& host = staging[name];
+    // a reply handed out earlier may still be held or viewed by an actor,
+    // only overwrite the staging tensor when we hold the last reference.
+    if (!host.defined() || host.sizes() != tensor.sizes() ||
+        host.dtype() != tensor.dtype() || host.use_count() > 1 ||
+        host.storage().use_count() > 1) {
+      host = torch::empty(tensor.sizes(),
+                          torch::TensorOptions()
+                              .dtype(tensor.dtype())
+                              .pinned_memory(true));
+    }
+    host.copy_(tensor);
+    map.emplace(name, host);
+  }
+  return map;
+}
+
 TensorDict tensorDictNarrow(const TensorDict& dict, int64_t dim, int64_t start,
                             int64_t len, bool squeeze, bool clone) {
   TensorDict result;
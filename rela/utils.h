@@ -12,6 +12,7 @@
 #include <utility>
 #include <vector>
 
+#include <ATen/Parallel.h>
 #include <torch/torch.h>
 
 #include "rela/logging.h"
@@ -20,6 +21,9 @@
 namespace rela {
 namespace utils {
 
+// samples per task when stacking a batch in parallel
+constexpr int64_t kStackGrainSize = 32;
+
 template <typename T>
 struct ToDataType;
 
@@ -159,12 +163,67 @@ TensorDict tensorDictJoin(const TensorVecDict& dict, int64_t dim);
 TensorDict vectorTensorDictJoin(const std::vector<TensorDict>& vec,
                                 int64_t dim);
 
+// Stacks get(0) .. get(n - 1) along dim like torch::stack, but allocates
+// the output once, pinned if asked, and copies the slices in parallel.
+// All inputs must have the shape of get(0).
+template <typename Get>
+torch::Tensor tensorStack(int64_t n, const Get& get, int64_t dim,
+                          bool pinMemory = false) {
+  RELA_CHECK_GT(n, 0);
+  const torch::Tensor& first = get(0);
+  std::vector<int64_t> sizes(first.sizes().begin(), first.sizes().end());
+  sizes.insert(sizes.begin() + dim, n);
+  auto out = torch::empty(sizes, first.options().pinned_memory(pinMemory));
+  at::parallel_for(0, n, kStackGrainSize, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      out.select(dim, i).copy_(get(i));
+    }
+  });
+  return out;
+}
+
+// tensorStack for every key of the dicts get(0) .. get(n - 1), which must
+// all have the keys of get(0).
+template <typename Get>
+TensorDict tensorDictStack(int64_t n, const Get& get, int64_t dim,
+                           bool pinMemory = false) {
+  RELA_CHECK_GT(n, 0);
+  const TensorDict& first = get(0);
+  std::vector<std::pair<const std::string*, torch::Tensor>> fields;
+  fields.reserve(first.size());
+  for (const auto& kv : first) {
+    std::vector<int64_t> sizes(kv.second.sizes().begin(),
+                               kv.second.sizes().end());
+    sizes.insert(sizes.begin() + dim, n);
+    fields.emplace_back(
+        &kv.first,
+        torch::empty(sizes, kv.second.options().pinned_memory(pinMemory)));
+  }
+  at::parallel_for(0, n, kStackGrainSize, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      const TensorDict& dict = get(i);
+      RELA_CHECK_EQ(dict.size(), fields.size());
+      for (auto& field : fields) {
+        field.second.select(dim, i).copy_(dict.at(*field.first));
+      }
+    }
+  });
+
+  TensorDict result;
+  result.reserve(fields.size());
+  for (auto& field : fields) {
+    result.emplace(*field.first, std::move(field.second));
+  }
+  return result;
+}
+
 // utils for convert dict[str, tensor] <-> ivalue
 inline TensorDict iValueToTensorDict(const torch::IValue& value,
                                      torch::DeviceType device,
                                      bool detach) {
   std::unordered_map<std::string, torch::Tensor> map;
   auto dict = value.toGenericDict();
+  map.reserve(dict.size());
   // auto ivalMap = dict->elements();
   for (auto& name2tensor : dict) {
     auto name = name2tensor.key().toString();
@@ -172,22 +231,54 @@ inline TensorDict iValueToTensorDict(const torch::IValue& value,
     if (detach) {
       tensor = tensor.detach();
     }
-    tensor = tensor.to(device);
-    map.insert({name->string(), tensor});
+    if (tensor.device().type() != device) {
+      tensor = tensor.to(device);
+    }
+    map.emplace(name->string(), std::move(tensor));
   }
   return map;
 }
 
+// Same as iValueToTensorDict(value, kCPU, true), but device outputs are
+// copied into host tensors kept in staging (pinned, reused once no reply
+// references them any more) instead of freshly allocated ones. CPU outputs
+// are passed through without copy.
+TensorDict iValueToTensorDict(const torch::IValue& value, TensorDict& staging);
+
 // TODO: this may be simplified with constructor in the future version
 inline TorchTensorDict tensorDictToTorchDict(const TensorDict& tensorDict,
                                              const torch::Device& device) {
   TorchTensorDict dict;
+  dict.reserve(tensorDict.size());
   for (const auto& name2tensor : tensorDict) {
-    dict.insert(name2tensor.first, name2tensor.second.to(device));
+    if (name2tensor.second.device() == device) {
+      dict.insert(name2tensor.first, name2tensor.second);
+    } else {
+      dict.insert(name2tensor.first, name2tensor.second.to(device));
+    }
   }
   return dict;
 }
 
+// Refills an existing dict so that a caller forwarding many batches with the
+// same keys does not rebuild it every time. Host to device copies are
+// non-blocking, which only overlaps when the source is pinned.
+inline void tensorDictToTorchDict(const TensorDict& tensorDict,
+                                  const torch::Device& device,
+                                  TorchTensorDict& dict) {
+  if (dict.size() != tensorDict.size()) {
+    dict.clear();
+  }
+  for (const auto& name2tensor : tensorDict) {
+    if (name2tensor.second.device() == device) {
+      dict.insert_or_assign(name2tensor.first, name2tensor.second);
+    } else {
+      dict.insert_or_assign(name2tensor.first,
+                            name2tensor.second.to(device, true));
+    }
+  }
+}
+
 inline void assertKeyExists(const TensorDict& tensorDict,
                             const std::vector<std::string>& keys) {
   for (const auto& k : keys) {
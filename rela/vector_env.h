@@ -0,0 +1,120 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "rela/logging.h"
+#include "rela/types.h"
+
+namespace rela {
+
+// K environments stepped together. feature() writes the observation of every
+// running env into row i of one [K, ...] tensor per field, so a whole vector
+// goes to the batcher in a single send (see Batcher::send with a row count),
+// and step() takes the K actions as one tensor.
+//
+// E is a rela::Env; envs that override Env::writeFeature fill their rows
+// without building a feature() of their own.
+template <class E>
+class VectorEnv {
+ public:
+  explicit VectorEnv(std::vector<std::shared_ptr<E>> envs)
+      : envs_(std::move(envs)) {
+    RELA_CHECK(!envs_.empty());
+  }
+
+  int size() const {
+    return (int)envs_.size();
+  }
+
+  E& env(int i) {
+    return *envs_.at(i);
+  }
+
+  const E& env(int i) const {
+    return *envs_.at(i);
+  }
+
+  // false if env i has no more games
+  bool reset(int i) {
+    return envs_.at(i)->reset();
+  }
+
+  // resets every env, false if any of them has no more games
+  bool reset() {
+    bool ok = true;
+    for (auto& env : envs_) {
+      ok = env->reset() && ok;
+    }
+    return ok;
+  }
+
+  bool terminated(int i) const {
+    return envs_.at(i)->terminated();
+  }
+
+  // [K] int64, player to move in each env, -1 for terminated ones
+  const torch::Tensor& playerIdx() {
+    if (!playerIdx_.defined()) {
+      playerIdx_ = torch::empty({size()}, torch::kInt64);
+    }
+    auto acc = playerIdx_.accessor<int64_t, 1>();
+    for (int i = 0; i < size(); ++i) {
+      acc[i] = envs_[i]->terminated() ? -1 : envs_[i]->playerIdx();
+    }
+    return playerIdx_;
+  }
+
+  // [K, ...] per field. The tensors are reused: they are rewritten in place
+  // by the next call, and rows of terminated envs keep stale values.
+  const TensorDict& feature() {
+    if (batch_.empty()) {
+      allocate();
+    }
+    for (int i = 0; i < size(); ++i) {
+      if (!envs_[i]->terminated()) {
+        envs_[i]->writeFeature(batch_, i);
+      }
+    }
+    return batch_;
+  }
+
+  // actions: [K] integer tensor, a negative action leaves its env alone
+  void step(const torch::Tensor& actions) {
+    RELA_CHECK_EQ(actions.dim(), 1);
+    RELA_CHECK_EQ(actions.size(0), size());
+    const auto a = actions.to(torch::kInt64);
+    auto acc = a.accessor<int64_t, 1>();
+    for (int i = 0; i < size(); ++i) {
+      if (acc[i] >= 0) {
+        RELA_CHECK(!envs_[i]->terminated(), "step on terminated env ", i);
+        envs_[i]->step(acc[i]);
+      }
+    }
+  }
+
+ private:
+  // field shapes and dtypes come from the first running env
+  void allocate() {
+    for (const auto& env : envs_) {
+      if (env->terminated()) {
+        continue;
+      }
+      for (const auto& kv : env->feature()) {
+        auto sizes = kv.second.sizes().vec();
+        sizes.insert(sizes.begin(), size());
+        batch_[kv.first] = torch::zeros(sizes, kv.second.options());
+      }
+      return;
+    }
+    RELA_CHECK(false, "every env is terminated, reset them first");
+  }
+
+  std::vector<std::shared_ptr<E>> envs_;
+  TensorDict batch_;
+  torch::Tensor playerIdx_;
+};
+
+}  // namespace rela
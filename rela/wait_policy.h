@@ -0,0 +1,151 @@
+// Copyright (c) Facebook, Inc. and its affiliates.
+// All rights reserved.
+//
+// This source code is licensed under the license found in the
+// LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <boost/fiber/condition_variable.hpp>
+#include <boost/fiber/mutex.hpp>
+
+// Wait policies used by Batcher and FutureReply. All of them share the same
+// interface:
+//
+//   wait(pred)   blocks until pred() is true.
+//   notifyAll()  called after the state read by pred() has changed.
+//
+// pred() only reads atomics, so waiters never need a lock to check it.
+
+namespace rela {
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+// Spins for a while, then sleeps on a futex. Meant for env loops running on
+// plain OS threads, where replies usually arrive within a few microseconds.
+// The futex word is a sequence number bumped by every notify, so a notify
+// that lands between checking pred() and going to sleep is never lost.
+//
+// Spinning only pays off while the notifier has a core of its own, so the
+// default spin is short and disabled altogether on a single core.
+class SpinFutexWait {
+ public:
+  explicit SpinFutexWait(int spinCount = defaultSpinCount())
+      : spinCount_(spinCount) {
+  }
+
+  static int defaultSpinCount() {
+    static const int count =
+        std::thread::hardware_concurrency() > 1 ? 100 : 0;
+    return count;
+  }
+
+  template <typename Pred>
+  void wait(const Pred& pred) {
+    for (int i = 0; i < spinCount_; ++i) {
+      if (pred()) {
+        return;
+      }
+      cpuRelax();
+    }
+
+    while (true) {
+      const uint32_t seq = seq_.load(std::memory_order_seq_cst);
+      if (pred()) {
+        return;
+      }
+      waiters_.fetch_add(1, std::memory_order_seq_cst);
+      syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq_),
+              FUTEX_WAIT_PRIVATE, seq, nullptr, nullptr, 0);
+      waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+  }
+
+  void notifyAll() {
+    seq_.fetch_add(1, std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_seq_cst) > 0) {
+      syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq_),
+              FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+  }
+
+ private:
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                "futex needs a plain 32 bit word");
+
+  const int spinCount_;
+  std::atomic<uint32_t> seq_{0};
+  std::atomic<int> waiters_{0};
+};
+
+// Suspends the calling fiber instead of the thread, for env loops that run
+// as boost fibers. Also works from plain threads, at the cost of the fiber
+// scheduler.
+class FiberWait {
+ public:
+  template <typename Pred>
+  void wait(const Pred& pred) {
+    if (pred()) {
+      return;
+    }
+    std::unique_lock<boost::fibers::mutex> lk(m_);
+    cv_.wait(lk, pred);
+  }
+
+  void notifyAll() {
+    { std::lock_guard<boost::fibers::mutex> lk(m_); }
+    cv_.notify_all();
+  }
+
+ private:
+  boost::fibers::mutex m_;
+  boost::fibers::condition_variable_any cv_;
+};
+
+// Plain mutex + condition variable, the reference point for the two above.
+class CondVarWait {
+ public:
+  template <typename Pred>
+  void wait(const Pred& pred) {
+    if (pred()) {
+      return;
+    }
+    std::unique_lock<std::mutex> lk(m_);
+    cv_.wait(lk, pred);
+  }
+
+  void notifyAll() {
+    { std::lock_guard<std::mutex> lk(m_); }
+    cv_.notify_all();
+  }
+
+ private:
+  std::mutex m_;
+  std::condition_variable cv_;
+};
+
+// define RELA_FIBER_WAIT when env loops are moved onto fibers.
+#ifdef RELA_FIBER_WAIT
+using WaitPolicy = FiberWait;
+#else
+using WaitPolicy = SpinFutexWait;
+#endif
+
+}  // namespace rela